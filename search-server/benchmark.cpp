@@ -0,0 +1,412 @@
+// Reproducible SearchServer benchmark.
+//
+// Builds a corpus with Zipf-distributed words and document lengths, then measures
+// indexing, queries, matching and removal. Every result is printed to stdout as one
+// JSON object per line, so runs can be diffed and tracked for regressions.
+//
+// Usage: search-server-benchmark [--documents N] [--vocabulary N] [--queries N]
+//                                [--threads 1,2,4,8] [--seed N] [--metrics 0|1] [--reorder 0|1]
+//                                [--numa 0|1]
+//
+// With --metrics 1 per-stage query metrics are collected and printed as the last line.
+// With --reorder 1 the index is reordered after the query benchmarks, the reorder stats are
+// printed and the queries are measured again as "query_reordered".
+// With --numa 1 the corpus is also indexed by a ShardedSearchServer with shards on every NUMA
+// node, and the queries are measured against it as "query_numa".
+
+#include "query_metrics.h"
+#include "search_server.h"
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct BenchmarkConfig {
+    int document_count = 50'000;
+    int vocabulary_size = 20'000;
+    int query_count = 5'000;
+    vector<int> thread_counts = {1, 2, 4, 8};
+    uint64_t seed = 42;
+    bool collect_metrics = false;
+    bool reorder_documents = false;
+    bool numa_placement = false;
+};
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(int n, double exponent) {
+        cumulative_.reserve(n);
+        double sum = 0;
+        for (int rank = 0; rank < n; ++rank) {
+            sum += 1.0 / pow(rank + 1, exponent);
+            cumulative_.push_back(sum);
+        }
+    }
+
+    template <typename Generator>
+    int operator()(Generator& generator) const {
+        const double point = uniform_real_distribution<double>(0, cumulative_.back())(generator);
+        return static_cast<int>(upper_bound(cumulative_.begin(), cumulative_.end(), point) - cumulative_.begin());
+    }
+
+private:
+    vector<double> cumulative_;
+};
+
+struct Corpus {
+    vector<string> vocabulary;  // ordered by frequency rank
+    vector<string> documents;
+    vector<DocumentStatus> statuses;
+    vector<vector<int>> ratings;
+};
+
+Corpus GenerateCorpus(mt19937_64& generator, const BenchmarkConfig& config) {
+    Corpus corpus;
+    // Frequent words are short, as in natural language
+    vector<string> words;
+    uniform_int_distribution<int> letter('a', 'z');
+    while (static_cast<int>(words.size()) < config.vocabulary_size) {
+        const int length = 2 + static_cast<int>(log2(words.size() + 2));
+        string word;
+        for (int i = 0; i < length; ++i) {
+            word.push_back(static_cast<char>(letter(generator)));
+        }
+        words.push_back(move(word));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    stable_sort(words.begin(), words.end(), [](const string& lhs, const string& rhs) {
+        return lhs.size() < rhs.size();
+    });
+    corpus.vocabulary = move(words);
+
+    const ZipfDistribution word_rank(corpus.vocabulary.size(), 1.0);
+    const ZipfDistribution length_rank(200, 0.8);
+    discrete_distribution<int> status({85, 10, 4, 1});
+    uniform_int_distribution<int> rating(-10, 10);
+    uniform_int_distribution<int> rating_count(0, 5);
+
+    for (int i = 0; i < config.document_count; ++i) {
+        const int length = 5 + length_rank(generator);
+        string document;
+        for (int j = 0; j < length; ++j) {
+            if (!document.empty()) {
+                document.push_back(' ');
+            }
+            document += corpus.vocabulary[word_rank(generator)];
+        }
+        corpus.documents.push_back(move(document));
+        corpus.statuses.push_back(static_cast<DocumentStatus>(status(generator)));
+        vector<int> document_ratings(rating_count(generator));
+        for (int& value : document_ratings) {
+            value = rating(generator);
+        }
+        corpus.ratings.push_back(move(document_ratings));
+    }
+    return corpus;
+}
+
+enum class QueryKind {
+    SHORT,
+    LONG,
+    MINUS_WORDS,
+    STATUS_FILTER,
+};
+
+struct BenchmarkQuery {
+    string text;
+    QueryKind kind;
+};
+
+const char* GetQueryKindName(QueryKind kind) {
+    switch (kind) {
+        case QueryKind::SHORT: return "short";
+        case QueryKind::LONG: return "long";
+        case QueryKind::MINUS_WORDS: return "minus_words";
+        case QueryKind::STATUS_FILTER: return "status_filter";
+    }
+    return "unknown";
+}
+
+vector<BenchmarkQuery> GenerateWorkload(mt19937_64& generator, const Corpus& corpus, int query_count) {
+    // Queries use a flatter distribution than documents: people search for rarer words
+    const ZipfDistribution word_rank(corpus.vocabulary.size(), 0.7);
+    discrete_distribution<int> kind({50, 20, 20, 10});
+    vector<BenchmarkQuery> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        const auto query_kind = static_cast<QueryKind>(kind(generator));
+        const int word_count = query_kind == QueryKind::LONG
+            ? uniform_int_distribution<int>(8, 20)(generator)
+            : uniform_int_distribution<int>(1, 3)(generator);
+        string text;
+        for (int j = 0; j < word_count; ++j) {
+            if (!text.empty()) {
+                text.push_back(' ');
+            }
+            text += corpus.vocabulary[word_rank(generator)];
+        }
+        if (query_kind == QueryKind::MINUS_WORDS) {
+            for (int j = 0; j < 2; ++j) {
+                text += " -"s + corpus.vocabulary[word_rank(generator)];
+            }
+        }
+        queries.push_back({move(text), query_kind});
+    }
+    return queries;
+}
+
+class LatencyRecorder {
+public:
+    void Add(Clock::duration latency) {
+        latencies_ns_.push_back(chrono::duration_cast<chrono::nanoseconds>(latency).count());
+    }
+
+    void Merge(const LatencyRecorder& other) {
+        latencies_ns_.insert(latencies_ns_.end(), other.latencies_ns_.begin(), other.latencies_ns_.end());
+    }
+
+    size_t GetCount() const {
+        return latencies_ns_.size();
+    }
+
+    // Sorts the samples, call after all Add and Merge calls
+    double GetPercentileMicroseconds(double percentile) {
+        if (latencies_ns_.empty()) {
+            return 0;
+        }
+        sort(latencies_ns_.begin(), latencies_ns_.end());
+        const size_t index = min(latencies_ns_.size() - 1, static_cast<size_t>(percentile * latencies_ns_.size()));
+        return latencies_ns_[index] / 1000.0;
+    }
+
+private:
+    vector<int64_t> latencies_ns_;
+};
+
+void PrintResult(string_view benchmark, string_view workload, int threads, Clock::duration wall_time, LatencyRecorder& latencies) {
+    const double seconds = chrono::duration<double>(wall_time).count();
+    cout << "{\"benchmark\":\""sv << benchmark
+         << "\",\"workload\":\""sv << workload
+         << "\",\"threads\":"sv << threads
+         << ",\"operations\":"sv << latencies.GetCount()
+         << ",\"seconds\":"sv << seconds
+         << ",\"throughput_ops\":"sv << (seconds > 0 ? latencies.GetCount() / seconds : 0.0)
+         << ",\"p50_us\":"sv << latencies.GetPercentileMicroseconds(0.50)
+         << ",\"p99_us\":"sv << latencies.GetPercentileMicroseconds(0.99)
+         << ",\"p999_us\":"sv << latencies.GetPercentileMicroseconds(0.999)
+         << "}"sv << endl;
+}
+
+// Runs operation(index) for index in [0, count) on thread_count threads, index % thread_count picks the thread
+template <typename Operation>
+void RunConcurrently(string_view benchmark, string_view workload, int thread_count, size_t count, Operation operation) {
+    vector<LatencyRecorder> recorders(thread_count);
+    const auto start = Clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t index = t; index < count; index += thread_count) {
+                const auto operation_start = Clock::now();
+                operation(index);
+                recorders[t].Add(Clock::now() - operation_start);
+            }
+        });
+    }
+    for (auto& worker : threads) {
+        worker.join();
+    }
+    const auto wall_time = Clock::now() - start;
+    LatencyRecorder total;
+    for (const auto& recorder : recorders) {
+        total.Merge(recorder);
+    }
+    PrintResult(benchmark, workload, thread_count, wall_time, total);
+}
+
+void BenchmarkIndexing(SearchServer& search_server, const Corpus& corpus) {
+    LatencyRecorder latencies;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        const auto operation_start = Clock::now();
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+        latencies.Add(Clock::now() - operation_start);
+    }
+    PrintResult("index"sv, "add_document"sv, 1, Clock::now() - start, latencies);
+}
+
+vector<Document> RunQuery(const SearchServer& search_server, const BenchmarkQuery& query) {
+    if (query.kind == QueryKind::STATUS_FILTER) {
+        return search_server.FindTopDocuments(execution::seq, query.text, DocumentStatus::BANNED);
+    }
+    return search_server.FindTopDocuments(execution::seq, query.text);
+}
+
+void BenchmarkQueries(string_view benchmark, const SearchServer& search_server, const vector<BenchmarkQuery>& queries, const BenchmarkConfig& config) {
+    for (const QueryKind kind : {QueryKind::SHORT, QueryKind::LONG, QueryKind::MINUS_WORDS, QueryKind::STATUS_FILTER}) {
+        vector<const BenchmarkQuery*> selected;
+        for (const auto& query : queries) {
+            if (query.kind == kind) {
+                selected.push_back(&query);
+            }
+        }
+        for (const int thread_count : config.thread_counts) {
+            RunConcurrently(benchmark, GetQueryKindName(kind), thread_count, selected.size(), [&](size_t index) {
+                RunQuery(search_server, *selected[index]);
+            });
+        }
+    }
+    // Intra-query parallelism: one caller, parallel policy inside
+    LatencyRecorder latencies;
+    const auto start = Clock::now();
+    for (const auto& query : queries) {
+        const auto operation_start = Clock::now();
+        search_server.FindTopDocuments(execution::par, query.text);
+        latencies.Add(Clock::now() - operation_start);
+    }
+    PrintResult(string(benchmark) + "_par_policy"s, "mixed"sv, 1, Clock::now() - start, latencies);
+}
+
+void BenchmarkNumaQueries(const Corpus& corpus, const vector<string>& stop_words, const vector<BenchmarkQuery>& queries, const BenchmarkConfig& config) {
+    const NumaPlacement placement;
+    ShardedSearchServer search_server(placement, stop_words);
+    cout << "{\"benchmark\":\"numa\",\"nodes\":"sv << placement.nodes.size()
+         << ",\"shards\":"sv << search_server.GetShardCount() << "}"sv << endl;
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], corpus.statuses[i], corpus.ratings[i]);
+    }
+    for (const int thread_count : config.thread_counts) {
+        RunConcurrently("query_numa"sv, "mixed"sv, thread_count, queries.size(), [&](size_t index) {
+            const BenchmarkQuery& query = queries[index];
+            if (query.kind == QueryKind::STATUS_FILTER) {
+                search_server.FindTopDocuments(query.text, DocumentStatus::BANNED);
+            } else {
+                search_server.FindTopDocuments(query.text);
+            }
+        });
+    }
+}
+
+void BenchmarkMatching(const SearchServer& search_server, const vector<BenchmarkQuery>& queries, const BenchmarkConfig& config) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    for (const int thread_count : config.thread_counts) {
+        RunConcurrently("match"sv, "match_document"sv, thread_count, queries.size(), [&](size_t index) {
+            search_server.MatchDocument(queries[index].text, document_ids[index % document_ids.size()]);
+        });
+    }
+}
+
+void BenchmarkRemoval(SearchServer& search_server, mt19937_64& generator) {
+    vector<int> document_ids(search_server.begin(), search_server.end());
+    shuffle(document_ids.begin(), document_ids.end(), generator);
+    document_ids.resize(document_ids.size() / 10);
+    LatencyRecorder latencies;
+    const auto start = Clock::now();
+    for (const int document_id : document_ids) {
+        const auto operation_start = Clock::now();
+        search_server.RemoveDocument(document_id);
+        latencies.Add(Clock::now() - operation_start);
+    }
+    PrintResult("remove"sv, "remove_document"sv, 1, Clock::now() - start, latencies);
+}
+
+vector<int> ParseThreadCounts(const string& text) {
+    vector<int> result;
+    istringstream input(text);
+    string item;
+    while (getline(input, item, ',')) {
+        const int thread_count = stoi(item);
+        if (thread_count <= 0) {
+            throw invalid_argument("Thread count must be positive"s);
+        }
+        result.push_back(thread_count);
+    }
+    return result;
+}
+
+BenchmarkConfig ParseArguments(int argc, char** argv) {
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--documents"sv) {
+            config.document_count = stoi(value);
+        } else if (name == "--vocabulary"sv) {
+            config.vocabulary_size = stoi(value);
+        } else if (name == "--queries"sv) {
+            config.query_count = stoi(value);
+        } else if (name == "--threads"sv) {
+            config.thread_counts = ParseThreadCounts(value);
+        } else if (name == "--seed"sv) {
+            config.seed = stoull(value);
+        } else if (name == "--metrics"sv) {
+            config.collect_metrics = value != "0"sv;
+        } else if (name == "--reorder"sv) {
+            config.reorder_documents = value != "0"sv;
+        } else if (name == "--numa"sv) {
+            config.numa_placement = value != "0"sv;
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (config.document_count <= 0 || config.vocabulary_size <= 0 || config.query_count <= 0) {
+        throw invalid_argument("Sizes must be positive"s);
+    }
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const BenchmarkConfig config = ParseArguments(argc, argv);
+        QueryMetrics::SetEnabled(config.collect_metrics);
+        mt19937_64 generator(config.seed);
+        const Corpus corpus = GenerateCorpus(generator, config);
+        const auto queries = GenerateWorkload(generator, corpus, config.query_count);
+
+        // The most frequent words are stop words, as in real indexes
+        const vector<string> stop_words(corpus.vocabulary.begin(), corpus.vocabulary.begin() + min<size_t>(10, corpus.vocabulary.size()));
+        SearchServer search_server(stop_words);
+
+        BenchmarkIndexing(search_server, corpus);
+        BenchmarkQueries("query"sv, search_server, queries, config);
+        if (config.reorder_documents) {
+            cout << "{\"benchmark\":\"reorder\",\"stats\":"sv << search_server.ReorderDocuments() << "}"sv << endl;
+            BenchmarkQueries("query_reordered"sv, search_server, queries, config);
+        }
+        if (config.numa_placement) {
+            BenchmarkNumaQueries(corpus, stop_words, queries, config);
+        }
+        BenchmarkMatching(search_server, queries, config);
+        BenchmarkRemoval(search_server, generator);
+
+        if (config.collect_metrics) {
+            cout << QueryMetrics::Snapshot() << endl;
+        }
+    } catch (const exception& e) {
+        cerr << "Benchmark failed: "sv << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Blocking FIFO of limited capacity connecting pipeline stages:
+// a fast producer waits for the consumer instead of buffering without bound.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity) {
+    }
+
+    // Waits for free space; returns false if the queue was closed
+    bool Push(T value) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] {
+            return is_closed_ || items_.size() < capacity_;
+        });
+        if (is_closed_) {
+            return false;
+        }
+        items_.push_back(std::move(value));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Waits for an item; nullopt once the queue is closed and drained
+    std::optional<T> Pop() {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] {
+            return is_closed_ || !items_.empty();
+        });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> result(std::move(items_.front()));
+        items_.pop_front();
+        not_full_.notify_one();
+        return result;
+    }
+
+    // Wakes all waiters: pushes fail from now on, pops drain the remaining items
+    void Close() {
+        std::lock_guard lock(mutex_);
+        is_closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> items_;
+    bool is_closed_ = false;
+};
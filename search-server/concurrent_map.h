@@ -1,57 +1,381 @@
+#pragma once
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <execution>
-#include <mutex>
-#include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using namespace std::string_literals;
 
+/*
+    Concurrent hash map from integral keys to small trivially copyable values.
+
+    Keys are spread over shards, each an open-addressing table with linear probing behind
+    its own mutex. Shards are padded to cache lines, so threads writing different shards
+    do not share lines. Writers lock one shard and bump its sequence counter; Find and
+    Contains take no lock: they read the table and retry if a writer got in between.
+
+    A table outgrown by its shard stays allocated until the map is destroyed, since a reader
+    may still be probing it; together these are smaller than the current table of the shard.
+*/
 template <typename Key, typename Value>
-class ConcurrentMap{
+class ConcurrentMap {
 private:
-    struct Bucket {
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MIN_TABLE_CAPACITY = 16;
+
+    enum SlotState : uint8_t {
+        EMPTY,
+        FULL,
+        ERASED,
+    };
+
+    // Fields are atomic so that lock-free readers never race with the writer
+    struct Slot {
+        std::atomic<uint8_t> state;
+        std::atomic<Key> key;
+        std::atomic<Value> value;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity)
+            : mask(capacity - 1)
+            , shift(64 - GetLog2(capacity))
+            , slots(new Slot[capacity]()) {
+        }
+
+        size_t mask;
+        // The home slot of a key is the top log2(capacity) bits of its hash
+        int shift;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
         std::mutex mutex;
-        std::map<Key, Value> map;
+        // Odd while a writer modifies the shard
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const Table*> table{nullptr};
+        std::atomic<size_t> size{0};
+        // FULL and ERASED slots of the current table
+        size_t used_slot_count = 0;
+        // The current table is the last one
+        std::vector<std::unique_ptr<Table>> tables;
+    };
+
+    // Locks a shard for modification and makes lock-free readers of it retry
+    class WriteGuard {
+    public:
+        explicit WriteGuard(Shard& shard)
+            : shard_(shard)
+            , lock_(shard.mutex) {
+            shard_.sequence.store(shard_.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        ~WriteGuard() {
+            shard_.sequence.store(shard_.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        WriteGuard(const WriteGuard&) = delete;
+        WriteGuard& operator=(const WriteGuard&) = delete;
+
+    private:
+        Shard& shard_;
+        std::lock_guard<std::mutex> lock_;
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integral keys!"s);
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integral keys!");
+    static_assert(std::is_trivially_copyable_v<Value> && std::atomic<Value>::is_always_lock_free,
+                  "ConcurrentMap values must fit a lock-free atomic");
 
-    struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+    // Exclusive access to the value of a key, default-constructed if the key is new.
+    // The shard stays locked while the Access lives; the value is stored back on destruction.
+    class Access {
+    public:
+        Access(const Key& key, ConcurrentMap& map, Shard& shard)
+            : guard_(shard)
+            , slot_(*map.FindOrInsert(shard, key).first)
+            , value_(slot_.value.load(std::memory_order_relaxed))
+            , ref_to_value(value_) {
+        }
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key])
-        {
+        ~Access() {
+            slot_.value.store(value_, std::memory_order_relaxed);
         }
+
+        Access(const Access&) = delete;
+        Access& operator=(const Access&) = delete;
+
+    private:
+        WriteGuard guard_;
+        Slot& slot_;
+        Value value_;
+
+    public:
+        Value& ref_to_value;
     };
 
-    explicit ConcurrentMap(size_t bucket_count) 
-        : buckets_(bucket_count) {
+    // Four shards per hardware thread
+    ConcurrentMap()
+        : ConcurrentMap(4 * std::max(1u, std::thread::hardware_concurrency())) {
+    }
+
+    // expected_size presizes the tables
+    explicit ConcurrentMap(size_t shard_count, size_t expected_size = 0)
+        : shards_(std::max<size_t>(shard_count, 1))
+        , initial_capacity_(GetCapacityFor(expected_size / shards_.size())) {
     }
 
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return {key, bucket};
+        return {key, *this, GetShard(key)};
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for(auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+    // Inserts the key with value if it is absent; returns whether it did
+    bool Insert(const Key& key, const Value& value) {
+        Shard& shard = GetShard(key);
+        WriteGuard guard(shard);
+        const auto [slot, is_inserted] = FindOrInsert(shard, key);
+        if (is_inserted) {
+            slot->value.store(value, std::memory_order_relaxed);
+        }
+        return is_inserted;
+    }
+
+    // Calls update(Value&) under the shard lock, inserting a default value first if the key is absent
+    template <typename Updater>
+    void Update(const Key& key, Updater update) {
+        Access access = (*this)[key];
+        update(access.ref_to_value);
+    }
+
+    // Lock-free; nullopt if the key is absent
+    std::optional<Value> Find(const Key& key) const {
+        const Shard& shard = GetShard(key);
+        while (true) {
+            const uint64_t sequence = shard.sequence.load(std::memory_order_acquire);
+            if (sequence % 2 == 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::optional<Value> result;
+            if (const Table* table = shard.table.load(std::memory_order_acquire)) {
+                if (const Slot* slot = FindSlot(*table, key)) {
+                    result = slot->value.load(std::memory_order_relaxed);
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shard.sequence.load(std::memory_order_relaxed) == sequence) {
+                return result;
+            }
+        }
+    }
+
+    bool Contains(const Key& key) const {
+        return Find(key).has_value();
+    }
+
+    // Returns the number of erased keys, 0 or 1
+    size_t erase(const Key& key) {
+        Shard& shard = GetShard(key);
+        WriteGuard guard(shard);
+        const Table* table = shard.table.load(std::memory_order_relaxed);
+        Slot* slot = table ? const_cast<Slot*>(FindSlot(*table, key)) : nullptr;
+        if (slot == nullptr) {
+            return 0;
+        }
+        // The slot stays used: probe sequences of other keys run through it
+        slot->state.store(ERASED, std::memory_order_relaxed);
+        shard.size.store(shard.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        return 1;
+    }
+
+    // Approximate while writers are active
+    size_t size() const {
+        size_t result = 0;
+        for (const Shard& shard : shards_) {
+            result += shard.size.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    // Snapshot in no particular order. All shards are locked at once, so the snapshot is
+    // consistent; they are copied in parallel under the policy.
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildVector(const ExecutionPolicy& policy) {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards_.size());
+        std::vector<size_t> offsets(shards_.size() + 1);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            locks.emplace_back(shards_[i].mutex);
+            offsets[i + 1] = offsets[i] + shards_[i].size.load(std::memory_order_relaxed);
         }
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::vector<size_t> shard_indexes(shards_.size());
+        std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+        std::for_each(policy, shard_indexes.begin(), shard_indexes.end(), [this, &offsets, &result](size_t index) {
+            auto output = result.begin() + offsets[index];
+            ForEachFull(shards_[index], [&output](const Slot& slot) {
+                *output++ = {slot.key.load(std::memory_order_relaxed), slot.value.load(std::memory_order_relaxed)};
+            });
+        });
         return result;
     }
 
-    void erase(const Key& key) {
-        buckets_[static_cast<uint64_t>(key) % buckets_.size()].map.erase(key);
+    std::vector<std::pair<Key, Value>> BuildVector() {
+        return BuildVector(std::execution::seq);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        const auto items = BuildVector(std::execution::seq);
+        return {items.begin(), items.end()};
     }
 
 private:
-    std::vector<Bucket> buckets_;
-};
\ No newline at end of file
+    std::vector<Shard> shards_;
+    const size_t initial_capacity_;
+
+    // Fibonacci hashing. Only the top bits of the product depend on every key bit, so they pick
+    // the slot; the low 32 bits, which ignore the key bits above them, pick the shard. The high
+    // half of a 64-bit key is folded into the low half first. Slot and shard bits do not overlap
+    // while a table has at most 2^32 slots.
+    static uint64_t Hash(const Key& key) {
+        const uint64_t value = static_cast<uint64_t>(key);
+        return (value ^ (value >> 32)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static size_t GetHomeSlot(const Table& table, const Key& key) {
+        return Hash(key) >> table.shift;
+    }
+
+    static int GetLog2(size_t capacity) {
+        int result = 0;
+        while ((size_t{1} << result) < capacity) {
+            ++result;
+        }
+        return result;
+    }
+
+    // Smallest power of two keeping size within the load factor of 3/4
+    static size_t GetCapacityFor(size_t size) {
+        size_t capacity = MIN_TABLE_CAPACITY;
+        while (capacity / 4 * 3 < size) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    size_t GetShardIndex(const Key& key) const {
+        // Scales the low 32 bits to the shard count, so their upper part decides
+        return (Hash(key) & 0xFFFFFFFFull) * shards_.size() >> 32;
+    }
+
+    Shard& GetShard(const Key& key) {
+        return shards_[GetShardIndex(key)];
+    }
+
+    const Shard& GetShard(const Key& key) const {
+        return shards_[GetShardIndex(key)];
+    }
+
+    static const Slot* FindSlot(const Table& table, const Key& key) {
+        for (size_t index = GetHomeSlot(table, key); ; index = (index + 1) & table.mask) {
+            const Slot& slot = table.slots[index];
+            const uint8_t state = slot.state.load(std::memory_order_relaxed);
+            if (state == EMPTY) {
+                return nullptr;
+            }
+            if (state == FULL && slot.key.load(std::memory_order_relaxed) == key) {
+                return &slot;
+            }
+        }
+    }
+
+    template <typename Visitor>
+    static void ForEachFull(const Shard& shard, Visitor visit) {
+        const Table* table = shard.table.load(std::memory_order_relaxed);
+        if (table == nullptr) {
+            return;
+        }
+        for (size_t index = 0; index <= table->mask; ++index) {
+            if (table->slots[index].state.load(std::memory_order_relaxed) == FULL) {
+                visit(table->slots[index]);
+            }
+        }
+    }
+
+    // The shard must be write-locked. Returns the slot of the key and whether it was inserted.
+    std::pair<Slot*, bool> FindOrInsert(Shard& shard, const Key& key) {
+        const Table* table = shard.table.load(std::memory_order_relaxed);
+        if (table != nullptr) {
+            if (const Slot* slot = FindSlot(*table, key)) {
+                return {const_cast<Slot*>(slot), false};
+            }
+        }
+        if (table == nullptr || shard.used_slot_count + 1 > (table->mask + 1) / 4 * 3) {
+            table = MakeRoom(shard);
+        }
+        // The first free slot of the probe sequence, erased ones are reused
+        size_t index = GetHomeSlot(*table, key);
+        while (table->slots[index].state.load(std::memory_order_relaxed) == FULL) {
+            index = (index + 1) & table->mask;
+        }
+        Slot& slot = table->slots[index];
+        if (slot.state.load(std::memory_order_relaxed) == EMPTY) {
+            ++shard.used_slot_count;
+        }
+        slot.key.store(key, std::memory_order_relaxed);
+        slot.value.store(Value{}, std::memory_order_relaxed);
+        slot.state.store(FULL, std::memory_order_relaxed);
+        shard.size.store(shard.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return {&slot, true};
+    }
+
+    // Frees a slot for one more key. Erased slots are dropped in place if the keys fill
+    // at most half of the table; otherwise the keys move to a table twice as large.
+    const Table* MakeRoom(Shard& shard) {
+        if (shard.tables.empty()) {
+            shard.tables.push_back(std::make_unique<Table>(initial_capacity_));
+            shard.table.store(shard.tables.back().get(), std::memory_order_release);
+            return shard.tables.back().get();
+        }
+        Table& table = *shard.tables.back();
+        std::vector<std::pair<Key, Value>> items;
+        items.reserve(shard.size.load(std::memory_order_relaxed));
+        ForEachFull(shard, [&items](const Slot& slot) {
+            items.emplace_back(slot.key.load(std::memory_order_relaxed), slot.value.load(std::memory_order_relaxed));
+        });
+        Table* target = &table;
+        if (items.size() + 1 > (table.mask + 1) / 2) {
+            shard.tables.push_back(std::make_unique<Table>(2 * (table.mask + 1)));
+            target = shard.tables.back().get();
+        } else {
+            for (size_t index = 0; index <= table.mask; ++index) {
+                table.slots[index].state.store(EMPTY, std::memory_order_relaxed);
+            }
+        }
+        for (const auto& [key, value] : items) {
+            size_t index = GetHomeSlot(*target, key);
+            while (target->slots[index].state.load(std::memory_order_relaxed) != EMPTY) {
+                index = (index + 1) & target->mask;
+            }
+            Slot& slot = target->slots[index];
+            slot.key.store(key, std::memory_order_relaxed);
+            slot.value.store(value, std::memory_order_relaxed);
+            slot.state.store(FULL, std::memory_order_relaxed);
+        }
+        shard.used_slot_count = items.size();
+        shard.table.store(target, std::memory_order_release);
+        return target;
+    }
+};
@@ -0,0 +1,226 @@
+// ConcurrentMap benchmark against the previous design: a std::map per bucket behind a mutex.
+//
+// Threads update or look up keys drawn from a skewed distribution, so the hot keys make
+// shards contended. Every result is printed as one JSON object per line, like
+// search-server-benchmark.
+//
+// Usage: search-server-map-benchmark [--keys N] [--operations N] [--threads 1,2,4,8]
+//                                    [--shards N] [--seed N]
+
+#include "concurrent_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct MapBenchmarkConfig {
+    int key_count = 100'000;
+    int operation_count = 2'000'000;
+    vector<int> thread_counts = {1, 2, 4, 8};
+    size_t shard_count = 64;
+    uint64_t seed = 42;
+};
+
+// The ConcurrentMap this repository had before: the baseline
+template <typename Key, typename Value>
+class TreeBucketMap {
+private:
+    struct Bucket {
+        mutex bucket_mutex;
+        map<Key, Value> items;
+    };
+
+public:
+    struct Access {
+        lock_guard<mutex> guard;
+        Value& ref_to_value;
+
+        Access(const Key& key, Bucket& bucket)
+            : guard(bucket.bucket_mutex)
+            , ref_to_value(bucket.items[key]) {
+        }
+    };
+
+    explicit TreeBucketMap(size_t bucket_count)
+        : buckets_(bucket_count) {
+    }
+
+    Access operator[](const Key& key) {
+        return {key, GetBucket(key)};
+    }
+
+    optional<Value> Find(const Key& key) {
+        Bucket& bucket = GetBucket(key);
+        lock_guard guard(bucket.bucket_mutex);
+        const auto it = bucket.items.find(key);
+        return it == bucket.items.end() ? nullopt : optional<Value>(it->second);
+    }
+
+    map<Key, Value> BuildOrdinaryMap() {
+        map<Key, Value> result;
+        for (auto& bucket : buckets_) {
+            lock_guard guard(bucket.bucket_mutex);
+            result.insert(bucket.items.begin(), bucket.items.end());
+        }
+        return result;
+    }
+
+private:
+    vector<Bucket> buckets_;
+
+    Bucket& GetBucket(const Key& key) {
+        return buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+    }
+};
+
+// Keys with a Zipf-like skew: a few of them take most of the operations
+vector<int> GenerateKeys(const MapBenchmarkConfig& config) {
+    mt19937_64 generator(config.seed);
+    vector<double> cumulative;
+    double sum = 0;
+    for (int rank = 0; rank < config.key_count; ++rank) {
+        sum += 1.0 / pow(rank + 1, 0.8);
+        cumulative.push_back(sum);
+    }
+    // Ranks are scattered over the key space, as document ids would be
+    vector<int> rank_to_key(config.key_count);
+    for (int rank = 0; rank < config.key_count; ++rank) {
+        rank_to_key[rank] = rank * 37;
+    }
+    shuffle(rank_to_key.begin(), rank_to_key.end(), generator);
+    uniform_real_distribution<double> point(0, sum);
+    vector<int> keys(config.operation_count);
+    for (int& key : keys) {
+        key = rank_to_key[upper_bound(cumulative.begin(), cumulative.end(), point(generator)) - cumulative.begin()];
+    }
+    return keys;
+}
+
+void PrintResult(string_view map_name, string_view workload, int threads, size_t operations, Clock::duration wall_time) {
+    const double seconds = chrono::duration<double>(wall_time).count();
+    cout << "{\"benchmark\":\"concurrent_map\",\"map\":\""sv << map_name
+         << "\",\"workload\":\""sv << workload
+         << "\",\"threads\":"sv << threads
+         << ",\"operations\":"sv << operations
+         << ",\"seconds\":"sv << seconds
+         << ",\"throughput_ops\":"sv << (seconds > 0 ? operations / seconds : 0.0)
+         << "}"sv << endl;
+}
+
+// Runs operation(index) for index in [0, count) on thread_count threads, index % thread_count picks the thread
+template <typename Operation>
+void RunConcurrently(string_view map_name, string_view workload, int thread_count, size_t count, Operation operation) {
+    const auto start = Clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t index = t; index < count; index += thread_count) {
+                operation(index);
+            }
+        });
+    }
+    for (auto& worker : threads) {
+        worker.join();
+    }
+    PrintResult(map_name, workload, thread_count, count, Clock::now() - start);
+}
+
+// Relevance accumulation as in FindAllDocuments(par), then lookups with one update in ten,
+// then the export of the result
+template <typename Map, typename Export>
+void BenchmarkMap(string_view map_name, const vector<int>& keys, const MapBenchmarkConfig& config, Export export_items) {
+    for (const int thread_count : config.thread_counts) {
+        Map items(config.shard_count);
+        RunConcurrently(map_name, "accumulate"sv, thread_count, keys.size(), [&](size_t index) {
+            items[keys[index]].ref_to_value += 1.0;
+        });
+        RunConcurrently(map_name, "read_mostly"sv, thread_count, keys.size(), [&](size_t index) {
+            if (index % 10 == 0) {
+                items[keys[index]].ref_to_value += 1.0;
+            } else {
+                items.Find(keys[index]);
+            }
+        });
+        const auto start = Clock::now();
+        const size_t exported_count = export_items(items);
+        PrintResult(map_name, "export"sv, thread_count, exported_count, Clock::now() - start);
+    }
+}
+
+vector<int> ParseThreadCounts(const string& text) {
+    vector<int> result;
+    istringstream input(text);
+    string item;
+    while (getline(input, item, ',')) {
+        const int thread_count = stoi(item);
+        if (thread_count <= 0) {
+            throw invalid_argument("Thread count must be positive"s);
+        }
+        result.push_back(thread_count);
+    }
+    return result;
+}
+
+MapBenchmarkConfig ParseArguments(int argc, char** argv) {
+    MapBenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--keys"sv) {
+            config.key_count = stoi(value);
+        } else if (name == "--operations"sv) {
+            config.operation_count = stoi(value);
+        } else if (name == "--threads"sv) {
+            config.thread_counts = ParseThreadCounts(value);
+        } else if (name == "--shards"sv) {
+            config.shard_count = stoul(value);
+        } else if (name == "--seed"sv) {
+            config.seed = stoull(value);
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (config.key_count <= 0 || config.operation_count <= 0 || config.shard_count == 0) {
+        throw invalid_argument("Sizes must be positive"s);
+    }
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const MapBenchmarkConfig config = ParseArguments(argc, argv);
+        const vector<int> keys = GenerateKeys(config);
+        BenchmarkMap<TreeBucketMap<int, double>>("tree_buckets"sv, keys, config, [](auto& items) {
+            return items.BuildOrdinaryMap().size();
+        });
+        BenchmarkMap<ConcurrentMap<int, double>>("open_addressing"sv, keys, config, [](auto& items) {
+            return items.BuildVector(execution::par).size();
+        });
+    } catch (const exception& e) {
+        cerr << "Benchmark failed: "sv << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,484 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+using namespace std;
+
+namespace {
+
+// Lines of the input starting at a line boundary
+struct CorpusChunk {
+    size_t sequence = 0;
+    uint64_t offset = 0;
+    // vector keeps its buffer on move, so record texts stay valid
+    vector<char> data;
+};
+
+struct CorpusRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    // Points into the data of the chunk
+    string_view text;
+};
+
+struct CorpusBatch {
+    size_t sequence = 0;
+    vector<char> data;
+    vector<CorpusRecord> records;
+};
+
+[[noreturn]] void ThrowRecordError(uint64_t offset, const string& what) {
+    throw invalid_argument("Corpus record at byte "s + to_string(offset) + ": "s + what);
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number "s + string(text));
+    }
+    return value;
+}
+
+void ParseTsvLine(string_view line, CorpusRecord& record) {
+    string_view fields[3];
+    for (string_view& field : fields) {
+        const size_t tab = line.find('\t');
+        if (tab == string_view::npos) {
+            throw invalid_argument("Expected 4 tab-separated fields"s);
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    record.id = ParseInt(fields[0]);
+    record.status = ParseDocumentStatus(fields[1]);
+    string_view ratings = fields[2];
+    while (!ratings.empty()) {
+        const size_t space = ratings.find(' ');
+        const string_view rating = ratings.substr(0, space);
+        if (!rating.empty()) {
+            record.ratings.push_back(ParseInt(rating));
+        }
+        ratings.remove_prefix(space == string_view::npos ? ratings.size() : space + 1);
+    }
+    record.text = line;
+}
+
+// Parses one JSON object per line, unescaping strings in place
+class JsonLineParser {
+public:
+    JsonLineParser(char* begin, char* end)
+        : position_(begin)
+        , end_(end) {
+    }
+
+    void Parse(CorpusRecord& record) {
+        bool has_id = false;
+        bool has_text = false;
+        Expect('{');
+        SkipSpace();
+        if (Peek() == '}') {
+            throw invalid_argument("Record has no id and text"s);
+        }
+        while (true) {
+            const string_view key = ParseString();
+            Expect(':');
+            SkipSpace();
+            if (key == "id"sv) {
+                record.id = ParseNumber();
+                has_id = true;
+            } else if (key == "status"sv) {
+                record.status = ParseDocumentStatus(Peek() == '"' ? ParseString() : to_string(ParseNumber()));
+            } else if (key == "ratings"sv) {
+                Expect('[');
+                SkipSpace();
+                if (Peek() != ']') {
+                    do {
+                        SkipSpace();
+                        record.ratings.push_back(ParseNumber());
+                        SkipSpace();
+                    } while (TryConsume(','));
+                }
+                Expect(']');
+            } else if (key == "text"sv) {
+                record.text = ParseString();
+                has_text = true;
+            } else {
+                SkipValue();
+            }
+            SkipSpace();
+            if (!TryConsume(',')) {
+                break;
+            }
+            SkipSpace();
+        }
+        Expect('}');
+        SkipSpace();
+        if (position_ != end_) {
+            throw invalid_argument("Unexpected characters after the object"s);
+        }
+        if (!has_id || !has_text) {
+            throw invalid_argument("Record must have id and text"s);
+        }
+    }
+
+private:
+    char* position_;
+    char* const end_;
+
+    char Peek() const {
+        if (position_ == end_) {
+            throw invalid_argument("Unexpected end of line"s);
+        }
+        return *position_;
+    }
+
+    void SkipSpace() {
+        while (position_ != end_ && (*position_ == ' ' || *position_ == '\t' || *position_ == '\r')) {
+            ++position_;
+        }
+    }
+
+    bool TryConsume(char c) {
+        if (position_ != end_ && *position_ == c) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c) {
+        SkipSpace();
+        if (!TryConsume(c)) {
+            throw invalid_argument("Expected '"s + c + "'"s);
+        }
+    }
+
+    int ParseNumber() {
+        int value = 0;
+        const auto [end, error] = from_chars(position_, end_, value);
+        if (error != errc{}) {
+            throw invalid_argument("Expected an integer"s);
+        }
+        position_ = const_cast<char*>(end);
+        return value;
+    }
+
+    unsigned ParseHex4() {
+        if (end_ - position_ < 4) {
+            throw invalid_argument("Truncated \\u escape"s);
+        }
+        unsigned value = 0;
+        const auto [end, error] = from_chars(position_, position_ + 4, value, 16);
+        if (error != errc{} || end != position_ + 4) {
+            throw invalid_argument("Invalid \\u escape"s);
+        }
+        position_ += 4;
+        return value;
+    }
+
+    static char* AppendUtf8(char* out, unsigned code_point) {
+        if (code_point < 0x80) {
+            *out++ = static_cast<char>(code_point);
+        } else if (code_point < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+            *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+        } else if (code_point < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+        }
+        return out;
+    }
+
+    // Unescaped text never gets longer, so it is written over the escaped one
+    string_view ParseString() {
+        Expect('"');
+        char* const begin = position_;
+        char* out = position_;
+        while (Peek() != '"') {
+            const char c = *position_++;
+            if (c != '\\') {
+                *out++ = c;
+                continue;
+            }
+            const char escape = Peek();
+            ++position_;
+            switch (escape) {
+            case '"': case '\\': case '/': *out++ = escape; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                unsigned code_point = ParseHex4();
+                if (code_point >= 0xD800 && code_point < 0xDC00 && end_ - position_ >= 6
+                    && position_[0] == '\\' && position_[1] == 'u') {
+                    position_ += 2;
+                    const unsigned low = ParseHex4();
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                }
+                out = AppendUtf8(out, code_point);
+                break;
+            }
+            default:
+                throw invalid_argument("Invalid escape \\"s + escape);
+            }
+        }
+        ++position_;
+        return {begin, static_cast<size_t>(out - begin)};
+    }
+
+    void SkipValue() {
+        SkipSpace();
+        const char c = Peek();
+        if (c == '"') {
+            ParseString();
+        } else if (c == '[' || c == '{') {
+            const char close = c == '[' ? ']' : '}';
+            ++position_;
+            SkipSpace();
+            if (TryConsume(close)) {
+                return;
+            }
+            do {
+                if (close == '}') {
+                    ParseString();
+                    Expect(':');
+                }
+                SkipValue();
+                SkipSpace();
+            } while (TryConsume(','));
+            Expect(close);
+        } else {
+            // Number, true, false or null
+            while (position_ != end_ && *position_ != ',' && *position_ != '}' && *position_ != ']'
+                   && *position_ != ' ' && *position_ != '\t') {
+                ++position_;
+            }
+        }
+    }
+};
+
+CorpusBatch ParseChunk(CorpusChunk chunk, CorpusFormat format) {
+    CorpusBatch batch;
+    batch.sequence = chunk.sequence;
+    char* position = chunk.data.data();
+    char* const end = position + chunk.data.size();
+    while (position != end) {
+        char* line_end = find(position, end, '\n');
+        char* const next_line = line_end == end ? end : line_end + 1;
+        if (line_end != position && line_end[-1] == '\r') {
+            --line_end;
+        }
+        if (line_end != position) {
+            CorpusRecord record;
+            try {
+                if (format == CorpusFormat::TSV) {
+                    ParseTsvLine(string_view(position, line_end - position), record);
+                } else {
+                    JsonLineParser(position, line_end).Parse(record);
+                }
+            } catch (const invalid_argument& e) {
+                ThrowRecordError(chunk.offset + (position - chunk.data.data()), e.what());
+            }
+            batch.records.push_back(move(record));
+        }
+        position = next_line;
+    }
+    batch.data = move(chunk.data);
+    return batch;
+}
+
+// Cuts the input into chunks ending at a line boundary
+class ChunkReader {
+public:
+    ChunkReader(istream& input, size_t chunk_size)
+        : input_(input)
+        , chunk_size_(chunk_size) {
+    }
+
+    bool Next(CorpusChunk& chunk) {
+        vector<char> data = move(carry_);
+        carry_.clear();
+        while (true) {
+            const size_t old_size = data.size();
+            data.resize(old_size + chunk_size_);
+            input_.read(data.data() + old_size, chunk_size_);
+            const size_t read_count = static_cast<size_t>(input_.gcount());
+            data.resize(old_size + read_count);
+            if (read_count < chunk_size_) {
+                if (input_.bad()) {
+                    throw runtime_error("Corpus read failed"s);
+                }
+                break;
+            }
+            const auto last_newline = find(data.rbegin(), data.rbegin() + read_count, '\n');
+            if (last_newline != data.rbegin() + read_count) {
+                // The incomplete last line goes to the next chunk
+                const size_t line_end = data.rend() - last_newline;
+                carry_.assign(data.begin() + line_end, data.end());
+                data.resize(line_end);
+                break;
+            }
+        }
+        if (data.empty()) {
+            return false;
+        }
+        chunk.sequence = sequence_++;
+        chunk.offset = offset_;
+        offset_ += data.size();
+        chunk.data = move(data);
+        return true;
+    }
+
+    uint64_t GetOffset() const {
+        return offset_;
+    }
+
+private:
+    istream& input_;
+    const size_t chunk_size_;
+    vector<char> carry_;
+    size_t sequence_ = 0;
+    uint64_t offset_ = 0;
+};
+
+} // namespace
+
+DocumentStatus ParseDocumentStatus(string_view text) {
+    static const pair<string_view, DocumentStatus> names[] = {
+        {"ACTUAL"sv, DocumentStatus::ACTUAL},
+        {"IRRELEVANT"sv, DocumentStatus::IRRELEVANT},
+        {"BANNED"sv, DocumentStatus::BANNED},
+        {"REMOVED"sv, DocumentStatus::REMOVED},
+    };
+    for (size_t i = 0; i < size(names); ++i) {
+        if (text == names[i].first || (text.size() == 1 && text[0] == static_cast<char>('0' + i))) {
+            return names[i].second;
+        }
+    }
+    throw invalid_argument("Unknown document status "s + string(text));
+}
+
+CorpusFormat GetCorpusFormat(const string& path) {
+    for (const string_view extension : {".jsonl"sv, ".json"sv}) {
+        if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+            return CorpusFormat::JSONL;
+        }
+    }
+    return CorpusFormat::TSV;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, istream& input, CorpusFormat format, const CorpusLoaderConfig& config) {
+    if (config.chunk_size == 0 || config.queue_capacity == 0) {
+        throw invalid_argument("Chunk size and queue capacity must be positive"s);
+    }
+    const int parser_count = config.parser_count > 0
+        ? config.parser_count
+        : max(1, static_cast<int>(thread::hardware_concurrency()) - 1);
+    const auto start_time = chrono::steady_clock::now();
+
+    BoundedQueue<CorpusChunk> chunks(config.queue_capacity);
+    BoundedQueue<CorpusBatch> batches(config.queue_capacity);
+    mutex error_mutex;
+    exception_ptr error;
+    auto fail = [&](exception_ptr current) {
+        {
+            lock_guard guard(error_mutex);
+            if (!error) {
+                error = current;
+            }
+        }
+        chunks.Close();
+        batches.Close();
+    };
+
+    ChunkReader reader(input, config.chunk_size);
+    thread reader_thread([&] {
+        try {
+            CorpusChunk chunk;
+            while (reader.Next(chunk) && chunks.Push(move(chunk))) {
+            }
+        } catch (...) {
+            fail(current_exception());
+        }
+        chunks.Close();
+    });
+
+    atomic<int> running_parsers = parser_count;
+    vector<thread> parser_threads;
+    for (int i = 0; i < parser_count; ++i) {
+        parser_threads.emplace_back([&] {
+            try {
+                while (auto chunk = chunks.Pop()) {
+                    if (!batches.Push(ParseChunk(move(*chunk), format))) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(current_exception());
+            }
+            if (--running_parsers == 0) {
+                batches.Close();
+            }
+        });
+    }
+
+    CorpusLoadStats stats;
+    try {
+        // Batches are indexed in file order: ascending ids keep posting lists append-only
+        map<size_t, CorpusBatch> waiting;
+        size_t next_sequence = 0;
+        while (auto batch = batches.Pop()) {
+            waiting.emplace(batch->sequence, move(*batch));
+            for (auto it = waiting.begin(); it != waiting.end() && it->first == next_sequence; it = waiting.erase(it)) {
+                for (const CorpusRecord& record : it->second.records) {
+                    search_server.AddDocument(record.id, record.text, record.status, record.ratings);
+                }
+                stats.document_count += it->second.records.size();
+                ++next_sequence;
+            }
+        }
+    } catch (...) {
+        fail(current_exception());
+    }
+
+    reader_thread.join();
+    for (thread& parser_thread : parser_threads) {
+        parser_thread.join();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+    stats.byte_count = reader.GetOffset();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const string& path, const CorpusLoaderConfig& config) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    return LoadCorpus(search_server, input, GetCorpusFormat(path), config);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "document.h"
+#include "search_server.h"
+
+/*
+    Streaming corpus ingestion.
+
+    TSV: one document per line, tab-separated
+        id <TAB> status <TAB> ratings separated by spaces <TAB> text
+    JSONL: one object per line
+        {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "white cat"}
+    with status and ratings optional. Status is a DocumentStatus name or number.
+
+    The input is read in large blocks cut at line boundaries. Parser threads turn blocks
+    into records, and the calling thread adds them to the index in file order. Stages are
+    connected by bounded queues, so reading, parsing and indexing overlap in constant memory.
+*/
+
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+struct CorpusLoaderConfig {
+    // Bytes read per block; a longer line extends its block
+    size_t chunk_size = 4 << 20;
+    // 0: one per hardware thread except the indexing one
+    int parser_count = 0;
+    // Blocks in flight between two stages
+    size_t queue_capacity = 8;
+};
+
+struct CorpusLoadStats {
+    size_t document_count = 0;
+    uint64_t byte_count = 0;
+    double seconds = 0;
+};
+
+// ACTUAL, IRRELEVANT, BANNED, REMOVED or their numbers
+DocumentStatus ParseDocumentStatus(std::string_view text);
+
+// JSONL for .jsonl and .json files, TSV otherwise
+CorpusFormat GetCorpusFormat(const std::string& path);
+
+// Throws std::invalid_argument with the byte offset of a malformed record
+// and rethrows errors of SearchServer::AddDocument
+CorpusLoadStats LoadCorpus(SearchServer& search_server, std::istream& input, CorpusFormat format, const CorpusLoaderConfig& config = {});
+CorpusLoadStats LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoaderConfig& config = {});
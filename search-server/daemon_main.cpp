@@ -0,0 +1,114 @@
+// Search daemon: loads an index and serves it over the binary protocol of search_protocol.h.
+//
+// Usage: search-server-daemon [--tcp host:port] [--unix path] [--index file]
+//                             [--stop-words "a the"] [--io-threads N] [--batch N]
+//                             [--memory-budget MiB] [--budget-policy reject|drop-forward-index]
+//                             [--reorder 0|1]
+//
+// Index file: TSV or JSONL corpus (.jsonl/.json), see corpus_loader.h.
+// The daemon runs until SIGINT or SIGTERM.
+
+#include "corpus_loader.h"
+#include "search_daemon.h"
+#include "search_server.h"
+
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct DaemonOptions {
+    SearchDaemonConfig daemon;
+    string index_path;
+    string stop_words;
+    size_t memory_budget = 0;
+    MemoryBudgetPolicy budget_policy = MemoryBudgetPolicy::REJECT_DOCUMENTS;
+    bool reorder_documents = false;
+};
+
+DaemonOptions ParseArguments(int argc, char** argv) {
+    DaemonOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--tcp"sv) {
+            options.daemon.tcp_address = value;
+        } else if (name == "--unix"sv) {
+            options.daemon.unix_socket_path = value;
+        } else if (name == "--index"sv) {
+            options.index_path = value;
+        } else if (name == "--stop-words"sv) {
+            options.stop_words = value;
+        } else if (name == "--io-threads"sv) {
+            options.daemon.io_thread_count = stoi(value);
+        } else if (name == "--batch"sv) {
+            options.daemon.max_batch_size = stoul(value);
+        } else if (name == "--memory-budget"sv) {
+            options.memory_budget = stoul(value) << 20;
+        } else if (name == "--budget-policy"sv) {
+            if (value == "reject"sv) {
+                options.budget_policy = MemoryBudgetPolicy::REJECT_DOCUMENTS;
+            } else if (value == "drop-forward-index"sv) {
+                options.budget_policy = MemoryBudgetPolicy::DROP_FORWARD_INDEX;
+            } else {
+                throw invalid_argument("Unknown budget policy "s + value);
+            }
+        } else if (name == "--reorder"sv) {
+            options.reorder_documents = value != "0"sv;
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const DaemonOptions options = ParseArguments(argc, argv);
+        SearchServer search_server(options.stop_words);
+        search_server.SetMemoryBudget(options.memory_budget, options.budget_policy);
+        if (!options.index_path.empty()) {
+            const CorpusLoadStats stats = LoadCorpus(search_server, options.index_path);
+            cerr << "Loaded "s << stats.document_count << " documents, "s
+                 << stats.byte_count / 1e6 / stats.seconds << " MB/s"s << endl;
+            if (options.reorder_documents) {
+                cerr << "Reordered documents: "s << search_server.ReorderDocuments() << endl;
+            }
+            cerr << "Index memory: "s << search_server.GetMemoryStats() << endl;
+        }
+
+        // Signals are blocked in every thread and taken synchronously by sigwait below
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        SearchDaemon daemon(search_server, options.daemon);
+        daemon.Start();
+        if (daemon.GetTcpPort() != 0) {
+            cerr << "Listening on TCP port "s << daemon.GetTcpPort() << endl;
+        }
+        if (!options.daemon.unix_socket_path.empty()) {
+            cerr << "Listening on "s << options.daemon.unix_socket_path << endl;
+        }
+        int signal_number = 0;
+        sigwait(&signals, &signal_number);
+        cerr << "Stopping on signal "s << signal_number << endl;
+        daemon.Stop();
+    } catch (const exception& e) {
+        cerr << "Daemon failed: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "document_reordering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+constexpr int BISECTION_ITERATIONS = 20;
+// Ranges this small are left in their order
+constexpr size_t BISECTION_LEAF_SIZE = 16;
+
+class GraphBisection {
+public:
+    GraphBisection(const vector<vector<int>>& document_terms, int term_count)
+        : document_terms_(document_terms)
+        , left_degrees_(term_count)
+        , right_degrees_(term_count)
+        , left_gains_(term_count)
+        , right_gains_(term_count)
+        , log2_(document_terms.size() + 2) {
+        for (size_t i = 1; i < log2_.size(); ++i) {
+            log2_[i] = std::log2(static_cast<double>(i));
+        }
+    }
+
+    void Bisect(vector<int>::iterator first, vector<int>::iterator last) {
+        const size_t size = last - first;
+        if (size <= BISECTION_LEAF_SIZE) {
+            return;
+        }
+        const auto middle = first + size / 2;
+        const size_t left_size = middle - first;
+        const size_t right_size = last - middle;
+
+        vector<int> terms;
+        for (auto it = first; it != last; ++it) {
+            auto& degrees = it < middle ? left_degrees_ : right_degrees_;
+            for (const int term : document_terms_[*it]) {
+                if (left_degrees_[term] == 0 && right_degrees_[term] == 0) {
+                    terms.push_back(term);
+                }
+                ++degrees[term];
+            }
+        }
+
+        vector<pair<double, int>> left_moves(left_size);
+        vector<pair<double, int>> right_moves(right_size);
+        for (int iteration = 0; iteration < BISECTION_ITERATIONS; ++iteration) {
+            // Cost saved by moving one posting of the term to the other side
+            for (const int term : terms) {
+                const int left_degree = left_degrees_[term];
+                const int right_degree = right_degrees_[term];
+                const double cost = GetTermCost(left_degree, left_size) + GetTermCost(right_degree, right_size);
+                left_gains_[term] = left_degree == 0 ? 0.0
+                    : cost - GetTermCost(left_degree - 1, left_size) - GetTermCost(right_degree + 1, right_size);
+                right_gains_[term] = right_degree == 0 ? 0.0
+                    : cost - GetTermCost(left_degree + 1, left_size) - GetTermCost(right_degree - 1, right_size);
+            }
+            auto fill_moves = [this](vector<int>::iterator part, vector<pair<double, int>>& moves, const vector<double>& gains) {
+                for (auto& move : moves) {
+                    const int document = *part++;
+                    double gain = 0.0;
+                    for (const int term : document_terms_[document]) {
+                        gain += gains[term];
+                    }
+                    move = {gain, document};
+                }
+                sort(moves.begin(), moves.end(), greater<>());
+            };
+            fill_moves(first, left_moves, left_gains_);
+            fill_moves(middle, right_moves, right_gains_);
+
+            // The best pairs are swapped while together they still save
+            size_t swap_count = 0;
+            while (swap_count < min(left_size, right_size)
+                   && left_moves[swap_count].first + right_moves[swap_count].first > 0) {
+                for (const int term : document_terms_[left_moves[swap_count].second]) {
+                    --left_degrees_[term];
+                    ++right_degrees_[term];
+                }
+                for (const int term : document_terms_[right_moves[swap_count].second]) {
+                    ++left_degrees_[term];
+                    --right_degrees_[term];
+                }
+                swap(left_moves[swap_count].second, right_moves[swap_count].second);
+                ++swap_count;
+            }
+            if (swap_count == 0) {
+                break;
+            }
+            transform(left_moves.begin(), left_moves.end(), first, [](const auto& move) {
+                return move.second;
+            });
+            transform(right_moves.begin(), right_moves.end(), middle, [](const auto& move) {
+                return move.second;
+            });
+        }
+
+        for (const int term : terms) {
+            left_degrees_[term] = 0;
+            right_degrees_[term] = 0;
+        }
+        Bisect(first, middle);
+        Bisect(middle, last);
+    }
+
+private:
+    const vector<vector<int>>& document_terms_;
+    // Documents of the current range containing each term, per half
+    vector<int> left_degrees_;
+    vector<int> right_degrees_;
+    vector<double> left_gains_;
+    vector<double> right_gains_;
+    // log2(i), the cost is evaluated a few times per term and iteration
+    vector<double> log2_;
+
+    // Estimated bits of degree postings of a term in a part of part_size documents:
+    // log2 of the average gap for each of them
+    double GetTermCost(int degree, size_t part_size) const {
+        return degree * (log2_[part_size] - log2_[degree + 1]);
+    }
+};
+
+} // namespace
+
+ostream& operator<<(ostream& out, const DocumentReorderStats& stats) {
+    const double postings = max<size_t>(stats.posting_count, 1);
+    return out << "{\"documents\":"s << stats.document_count
+               << ",\"postings\":"s << stats.posting_count
+               << ",\"encoded_bytes_before\":"s << stats.encoded_size_before
+               << ",\"encoded_bytes_after\":"s << stats.encoded_size_after
+               << ",\"bits_per_posting_before\":"s << stats.encoded_size_before * 8 / postings
+               << ",\"bits_per_posting_after\":"s << stats.encoded_size_after * 8 / postings
+               << ",\"compression\":"s << static_cast<double>(stats.encoded_size_before) / max<size_t>(stats.encoded_size_after, 1)
+               << ",\"seconds\":"s << stats.seconds
+               << '}';
+}
+
+vector<int> ComputeBisectionOrder(const vector<vector<int>>& document_terms, int term_count) {
+    vector<int> order(document_terms.size());
+    iota(order.begin(), order.end(), 0);
+    GraphBisection(document_terms, term_count).Bisect(order.begin(), order.end());
+    return order;
+}
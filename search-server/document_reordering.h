@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Result of SearchServer::ReorderDocuments
+struct DocumentReorderStats {
+    size_t document_count = 0;
+    size_t posting_count = 0;
+    // Postings as varint-coded id gaps, see PostingList::GetEncodedSize
+    size_t encoded_size_before = 0;
+    size_t encoded_size_after = 0;
+    double seconds = 0;
+};
+
+// Prints the stats as one JSON object with bits per posting and the compression gained
+std::ostream& operator<<(std::ostream& out, const DocumentReorderStats& stats);
+
+// Order of documents that puts those with similar vocabularies next to each other, computed by
+// recursive graph bisection (Dhulipala et al., 2016): every half of a range is refined by swaps
+// that lower the estimated size of gap-coded postings, then bisected further.
+// document_terms[i] lists the term numbers of document i, all below term_count.
+// Returns the document numbers in their new order.
+std::vector<int> ComputeBisectionOrder(const std::vector<std::vector<int>>& document_terms, int term_count);
@@ -0,0 +1,167 @@
+#include "impact_postings.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+using namespace std;
+
+ImpactPostings::ImpactPostings(const PostingList& postings) {
+    const vector<int>& ids = postings.GetDocumentIds();
+    const vector<double>& freqs = postings.GetTermFreqs();
+    vector<size_t> order(ids.size());
+    iota(order.begin(), order.end(), 0);
+    // Ids are already ascending, so a stable sort keeps ties in id order
+    stable_sort(order.begin(), order.end(), [&freqs](size_t lhs, size_t rhs) {
+        return freqs[lhs] > freqs[rhs];
+    });
+
+    document_ids_.reserve(order.size());
+    term_freqs_.reserve(order.size());
+    for (const size_t index : order) {
+        document_ids_.push_back(ids[index]);
+        term_freqs_.push_back(freqs[index]);
+    }
+    for (size_t begin = 0, tier_size = FIRST_TIER_SIZE; begin < size(); begin += tier_size, tier_size *= 2) {
+        tier_begins_.push_back(begin);
+    }
+    tier_begins_.push_back(size());
+}
+
+size_t ImpactPostings::size() const {
+    return document_ids_.size();
+}
+
+size_t ImpactPostings::GetTierCount() const {
+    return tier_begins_.size() - 1;
+}
+
+size_t ImpactPostings::GetTierBegin(size_t tier) const {
+    return tier_begins_[tier];
+}
+
+double ImpactPostings::GetTierMaxTermFreq(size_t tier) const {
+    return term_freqs_[tier_begins_[tier]];
+}
+
+const vector<int>& ImpactPostings::GetDocumentIds() const {
+    return document_ids_;
+}
+
+const vector<double>& ImpactPostings::GetTermFreqs() const {
+    return term_freqs_;
+}
+
+size_t ImpactPostings::GetMemoryUsage() const {
+    return sizeof(*this)
+        + document_ids_.capacity() * sizeof(int)
+        + term_freqs_.capacity() * sizeof(double)
+        + tier_begins_.capacity() * sizeof(size_t);
+}
+
+ImpactPostingsCache::ImpactPostingsCache(size_t capacity)
+    : capacity_(capacity) {
+}
+
+ImpactPostingsCache::ImpactPostingsCache(const ImpactPostingsCache& other)
+    : capacity_(other.capacity_) {
+    CopyFrom(other);
+}
+
+ImpactPostingsCache& ImpactPostingsCache::operator=(const ImpactPostingsCache& other) {
+    if (this != &other) {
+        Clear();
+        capacity_ = other.capacity_;
+        CopyFrom(other);
+    }
+    return *this;
+}
+
+void ImpactPostingsCache::Invalidate(string_view word) {
+    // Writers never run alongside readers, so the map is read without the lock: adding a
+    // document costs no locking for words that were never cached
+    Shard& shard = GetShard(word);
+    if (shard.entries.empty()) {
+        return;
+    }
+    const auto it = shard.entries.find(word);
+    if (it != shard.entries.end()) {
+        lock_guard guard(shard.mutex);
+        shard.memory_usage -= it->second.memory_usage;
+        shard.entries.erase(it);
+    }
+}
+
+void ImpactPostingsCache::Clear() {
+    for (Shard& shard : shards_) {
+        lock_guard guard(shard.mutex);
+        shard.entries.clear();
+        shard.memory_usage = 0;
+    }
+}
+
+shared_ptr<const ImpactPostings> ImpactPostingsCache::Get(string_view word, const PostingList& postings) const {
+    if (postings.size() < MIN_CACHED_POSTINGS) {
+        return make_shared<const ImpactPostings>(postings);
+    }
+    Shard& shard = GetShard(word);
+    {
+        shared_lock guard(shard.mutex);
+        const auto it = shard.entries.find(word);
+        if (it != shard.entries.end()) {
+            // Stores only when the recency changes, so hot words do not bounce a cache line
+            if (it->second.last_use.load(memory_order_relaxed) != shard.insertion_count) {
+                it->second.last_use.store(shard.insertion_count, memory_order_relaxed);
+            }
+            return it->second.postings;
+        }
+    }
+    auto impacts = make_shared<const ImpactPostings>(postings);
+    const size_t memory_usage = sizeof(Entry) + word.size() + impacts->GetMemoryUsage();
+    if (memory_usage > capacity_ / SHARD_COUNT) {
+        return impacts;
+    }
+    lock_guard guard(shard.mutex);
+    const auto it = shard.entries.find(word);
+    if (it != shard.entries.end()) {
+        return it->second.postings;
+    }
+    Insert(shard, string(word), impacts, memory_usage);
+    return impacts;
+}
+
+size_t ImpactPostingsCache::GetMemoryUsage() const {
+    size_t result = sizeof(*this);
+    for (const Shard& shard : shards_) {
+        result += shard.memory_usage.load(memory_order_relaxed);
+    }
+    return result;
+}
+
+ImpactPostingsCache::Shard& ImpactPostingsCache::GetShard(string_view word) const {
+    return shards_[hash<string_view>{}(word) % SHARD_COUNT];
+}
+
+void ImpactPostingsCache::Insert(Shard& shard, string word, shared_ptr<const ImpactPostings> postings, size_t memory_usage) const {
+    // Evicts the words read longest ago until the new one fits
+    while (!shard.entries.empty() && shard.memory_usage + memory_usage > capacity_ / SHARD_COUNT) {
+        const auto oldest = min_element(shard.entries.begin(), shard.entries.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.second.last_use.load(memory_order_relaxed) < rhs.second.last_use.load(memory_order_relaxed);
+        });
+        shard.memory_usage -= oldest->second.memory_usage;
+        shard.entries.erase(oldest);
+    }
+    ++shard.insertion_count;
+    shard.entries.try_emplace(move(word), move(postings), memory_usage, shard.insertion_count);
+    shard.memory_usage += memory_usage;
+}
+
+void ImpactPostingsCache::CopyFrom(const ImpactPostingsCache& other) {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        shared_lock other_guard(other.shards_[i].mutex);
+        lock_guard guard(shards_[i].mutex);
+        for (const auto& [word, entry] : other.shards_[i].entries) {
+            Insert(shards_[i], word, entry.postings, entry.memory_usage);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "posting_list.h"
+
+// Postings of a word ordered by descending term frequency (impact), ties by id.
+// Split into tiers of doubling size: evaluation reads the high-impact tiers first
+// and may stop before the long low-impact tail.
+class ImpactPostings {
+public:
+    static constexpr size_t FIRST_TIER_SIZE = 64;
+
+    explicit ImpactPostings(const PostingList& postings);
+
+    size_t size() const;
+    size_t GetTierCount() const;
+    // Postings of a tier are [GetTierBegin(tier), GetTierBegin(tier + 1))
+    size_t GetTierBegin(size_t tier) const;
+    // Highest term frequency in the tier and in every tier after it
+    double GetTierMaxTermFreq(size_t tier) const;
+
+    const std::vector<int>& GetDocumentIds() const;
+    const std::vector<double>& GetTermFreqs() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    std::vector<size_t> tier_begins_;
+};
+
+// Impact-ordered copies of long postings of queried words, built on first use and kept within
+// a memory capacity: each shard of the cache evicts its least recently used words.
+// Hits share a shard lock; a miss sorts the copy outside any lock, so concurrent misses of
+// one word may both sort it and the first one is kept.
+// Readers may call Get concurrently; Invalidate and Clear must not race with readers.
+class ImpactPostingsCache {
+public:
+    // Shorter postings are sorted on every use, they cost little and would crowd the cache
+    static constexpr size_t MIN_CACHED_POSTINGS = 4 * ImpactPostings::FIRST_TIER_SIZE;
+    static constexpr size_t DEFAULT_CAPACITY = 64 << 20;
+
+    explicit ImpactPostingsCache(size_t capacity = DEFAULT_CAPACITY);
+    ImpactPostingsCache(const ImpactPostingsCache& other);
+    ImpactPostingsCache& operator=(const ImpactPostingsCache& other);
+
+    // Drops the copy of a word whose postings changed
+    void Invalidate(std::string_view word);
+    void Clear();
+
+    std::shared_ptr<const ImpactPostings> Get(std::string_view word, const PostingList& postings) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        Entry(std::shared_ptr<const ImpactPostings> postings, size_t memory_usage, uint64_t last_use)
+            : postings(std::move(postings))
+            , memory_usage(memory_usage)
+            , last_use(last_use) {
+        }
+
+        std::shared_ptr<const ImpactPostings> postings;
+        size_t memory_usage;
+        // Value of the shard's insertion count when the word was last read
+        mutable std::atomic<uint64_t> last_use;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::map<std::string, Entry, std::less<>> entries;
+        // Changes only under the exclusive lock
+        std::atomic<size_t> memory_usage{0};
+        uint64_t insertion_count = 0;
+    };
+
+    size_t capacity_;
+    mutable std::array<Shard, SHARD_COUNT> shards_;
+
+    Shard& GetShard(std::string_view word) const;
+    // The shard must be locked exclusively
+    void Insert(Shard& shard, std::string word, std::shared_ptr<const ImpactPostings> postings, size_t memory_usage) const;
+    void CopyFrom(const ImpactPostingsCache& other);
+};
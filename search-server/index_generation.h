@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Version of an index state: advances on every modification and is never shared by two
+// indexes, not even by a copy and its original, so data resolved against one state can
+// check that it still applies
+class IndexGeneration {
+public:
+    IndexGeneration()
+        : value_(Next()) {
+    }
+
+    IndexGeneration(const IndexGeneration&)
+        : value_(Next()) {
+    }
+
+    IndexGeneration& operator=(const IndexGeneration&) {
+        value_ = Next();
+        return *this;
+    }
+
+    void Advance() {
+        value_ = Next();
+    }
+
+    uint64_t Get() const {
+        return value_;
+    }
+
+private:
+    static uint64_t Next() {
+        static std::atomic<uint64_t> last_value = 0;
+        return last_value.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    uint64_t value_;
+};
@@ -0,0 +1,250 @@
+// Load generator for search-server-daemon.
+//
+// Opens several connections and keeps a fixed number of FindTopDocuments requests in
+// flight on each of them, cycling through the queries of a file. Prints one JSON line
+// with throughput and latency percentiles, like search-server-benchmark.
+//
+// Usage: search-server-loadgen (--tcp host:port | --unix path) --queries file
+//                              [--requests N] [--connections N] [--pipeline N]
+
+#include "query_metrics.h"
+#include "search_protocol.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct LoadConfig {
+    string tcp_address;
+    string unix_socket_path;
+    string queries_path;
+    int request_count = 100'000;
+    int connection_count = 4;
+    int pipeline_depth = 16;
+};
+
+struct ConnectionResult {
+    LatencyHistogram latencies;
+    uint64_t errors = 0;
+};
+
+int Connect(const LoadConfig& config) {
+    if (!config.unix_socket_path.empty()) {
+        sockaddr_un address{};
+        if (config.unix_socket_path.size() >= sizeof(address.sun_path)) {
+            throw invalid_argument("Unix socket path is too long"s);
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, config.unix_socket_path.c_str(), config.unix_socket_path.size() + 1);
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            throw runtime_error("Cannot connect to "s + config.unix_socket_path + ": "s + strerror(errno));
+        }
+        return fd;
+    }
+
+    const size_t colon = config.tcp_address.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("TCP address must be host:port"s);
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    const string host = config.tcp_address.substr(0, colon);
+    const string service = config.tcp_address.substr(colon + 1);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+        throw runtime_error("Cannot resolve "s + config.tcp_address);
+    }
+    const int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const bool is_connected = fd >= 0 && connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+    freeaddrinfo(addresses);
+    if (!is_connected) {
+        throw runtime_error("Cannot connect to "s + config.tcp_address + ": "s + strerror(errno));
+    }
+    return fd;
+}
+
+void SendAll(int fd, const string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        const ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0) {
+            throw runtime_error("send failed: "s + strerror(errno));
+        }
+        sent += count;
+    }
+}
+
+// Sends request_count queries keeping pipeline_depth of them in flight
+ConnectionResult RunConnection(const LoadConfig& config, const vector<string>& queries, int request_count, size_t first_query) {
+    ConnectionResult result;
+    const int fd = Connect(config);
+    vector<Clock::time_point> send_times(request_count);
+    string output;
+    string input;
+    int sent = 0;
+    int received = 0;
+    auto send_more = [&]() {
+        output.clear();
+        while (sent < request_count && sent - received < config.pipeline_depth) {
+            ProtocolRequest request;
+            request.request_id = static_cast<uint32_t>(sent);
+            request.type = RequestType::FIND_TOP_DOCUMENTS;
+            request.text = queries[(first_query + sent) % queries.size()];
+            AppendRequestFrame(request, output);
+            send_times[sent++] = Clock::now();
+        }
+        if (!output.empty()) {
+            SendAll(fd, output);
+        }
+    };
+
+    send_more();
+    char buffer[64 * 1024];
+    while (received < request_count) {
+        const ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            close(fd);
+            throw runtime_error("Connection closed by the daemon"s);
+        }
+        input.append(buffer, count);
+        size_t offset = 0;
+        for (size_t frame_size; (frame_size = GetFrameSize(string_view(input).substr(offset))) > 0; offset += frame_size) {
+            const ProtocolResponse response = ParseResponseFrame(string_view(input).substr(offset, frame_size), RequestType::FIND_TOP_DOCUMENTS);
+            const auto latency = Clock::now() - send_times.at(response.request_id);
+            result.latencies.Add(chrono::duration_cast<chrono::nanoseconds>(latency).count());
+            if (response.status != ResponseStatus::OK) {
+                ++result.errors;
+            }
+            ++received;
+        }
+        input.erase(0, offset);
+        send_more();
+    }
+    close(fd);
+    return result;
+}
+
+vector<string> ReadQueries(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    vector<string> queries;
+    for (string line; getline(input, line);) {
+        if (!line.empty()) {
+            queries.push_back(move(line));
+        }
+    }
+    if (queries.empty()) {
+        throw invalid_argument("No queries in "s + path);
+    }
+    return queries;
+}
+
+LoadConfig ParseArguments(int argc, char** argv) {
+    LoadConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--tcp"sv) {
+            config.tcp_address = value;
+        } else if (name == "--unix"sv) {
+            config.unix_socket_path = value;
+        } else if (name == "--queries"sv) {
+            config.queries_path = value;
+        } else if (name == "--requests"sv) {
+            config.request_count = stoi(value);
+        } else if (name == "--connections"sv) {
+            config.connection_count = stoi(value);
+        } else if (name == "--pipeline"sv) {
+            config.pipeline_depth = stoi(value);
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (config.tcp_address.empty() == config.unix_socket_path.empty()) {
+        throw invalid_argument("Exactly one of --tcp and --unix is required"s);
+    }
+    if (config.queries_path.empty()) {
+        throw invalid_argument("--queries is required"s);
+    }
+    if (config.request_count <= 0 || config.connection_count <= 0 || config.pipeline_depth <= 0) {
+        throw invalid_argument("Counts must be positive"s);
+    }
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const LoadConfig config = ParseArguments(argc, argv);
+        const vector<string> queries = ReadQueries(config.queries_path);
+
+        vector<ConnectionResult> results(config.connection_count);
+        vector<thread> threads;
+        atomic<bool> has_failed = false;
+        const auto start_time = Clock::now();
+        for (int i = 0; i < config.connection_count; ++i) {
+            // Requests are spread evenly, the first connections take the remainder
+            const int request_count = config.request_count / config.connection_count + (i < config.request_count % config.connection_count ? 1 : 0);
+            threads.emplace_back([&, i, request_count] {
+                try {
+                    results[i] = RunConnection(config, queries, request_count, i * queries.size() / config.connection_count);
+                } catch (const exception& e) {
+                    cerr << "Connection "s << i << " failed: "s << e.what() << endl;
+                    has_failed = true;
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start_time).count();
+        if (has_failed) {
+            return 1;
+        }
+
+        LatencyHistogram latencies;
+        uint64_t errors = 0;
+        for (const ConnectionResult& result : results) {
+            latencies += result.latencies;
+            errors += result.errors;
+        }
+        cout << "{\"requests\":"s << latencies.GetCount()
+             << ",\"errors\":"s << errors
+             << ",\"connections\":"s << config.connection_count
+             << ",\"pipeline\":"s << config.pipeline_depth
+             << ",\"seconds\":"s << seconds
+             << ",\"qps\":"s << latencies.GetCount() / seconds
+             << ",\"p50_us\":"s << latencies.GetPercentile(0.5) / 1000.0
+             << ",\"p99_us\":"s << latencies.GetPercentile(0.99) / 1000.0
+             << ",\"p999_us\":"s << latencies.GetPercentile(0.999) / 1000.0
+             << '}' << endl;
+    } catch (const exception& e) {
+        cerr << "Load generator failed: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include "memory_stats.h"
+
+using namespace std;
+
+ostream& operator<<(ostream& out, const IndexMemoryStats& stats) {
+    return out << "{\"inverted_index\":"s << stats.inverted_index
+               << ",\"forward_index\":"s << stats.forward_index
+               << ",\"documents\":"s << stats.documents
+               << ",\"stop_words\":"s << stats.stop_words
+               << ",\"caches\":"s << stats.caches
+               << ",\"index_total\":"s << stats.GetIndexTotal()
+               << ",\"total\":"s << stats.GetTotal()
+               << ",\"budget\":"s << stats.budget
+               << ",\"has_forward_index\":"s << (stats.has_forward_index ? "true"s : "false"s)
+               << '}';
+}
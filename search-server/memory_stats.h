@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Heap bytes of the index structures as requested from the allocator, without its own overhead.
+// The owners count node and buffer sizes on every insertion and erasure, so a report costs O(1).
+struct IndexMemoryStats {
+    // word_to_document_freqs_: tree nodes, word buffers and postings
+    size_t inverted_index = 0;
+    // document_to_word_freqs_, 0 once dropped
+    size_t forward_index = 0;
+    // documents_ and document_ids_
+    size_t documents = 0;
+    size_t stop_words = 0;
+    // Rebuilt on demand and not subject to the budget: term dictionary,
+    // impact-ordered postings, the bounded cache of reconstructed word frequencies
+    size_t caches = 0;
+    // 0: unlimited
+    size_t budget = 0;
+    bool has_forward_index = true;
+
+    // The part the budget applies to
+    size_t GetIndexTotal() const {
+        return inverted_index + forward_index + documents + stop_words;
+    }
+
+    size_t GetTotal() const {
+        return GetIndexTotal() + caches;
+    }
+};
+
+// Prints the stats as one JSON object
+std::ostream& operator<<(std::ostream& out, const IndexMemoryStats& stats);
+
+// What AddDocument does once the index has reached its memory budget
+enum class MemoryBudgetPolicy {
+    // Throw MemoryBudgetExceeded
+    REJECT_DOCUMENTS,
+    // Drop the forward index first and reject only if that is not enough;
+    // document words are then reconstructed from the inverted index
+    DROP_FORWARD_INDEX,
+};
+
+class MemoryBudgetExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Size of a std::map or std::set node: color, three links and the value (libstdc++ and libc++ layout)
+template <typename Value>
+constexpr size_t GetTreeNodeSize() {
+    constexpr size_t alignment = std::max(alignof(void*), alignof(Value));
+    return (4 * sizeof(void*) + sizeof(Value) + alignment - 1) / alignment * alignment;
+}
+
+// Heap buffer of a string, 0 while it fits in the small string buffer
+inline size_t GetHeapSize(const std::string& text) {
+    static const size_t small_capacity = std::string().capacity();
+    return text.capacity() > small_capacity ? text.capacity() + 1 : 0;
+}
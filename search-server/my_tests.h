@@ -57,7 +57,7 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
 }
 
 template <typename ExecutionPolicy>
-void Test(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
+void Test(string_view mark, const SearchServer& search_server, const string& query, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
     std::vector<Document> res = search_server.FindTopDocuments(policy, query);
 }
@@ -0,0 +1,156 @@
+#include "numa_topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+int ParseCpuNumber(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc{} || end != text.data() + text.size() || text.empty()) {
+        throw invalid_argument("Invalid CPU list"s);
+    }
+    return value;
+}
+
+// CPUs the process may run on; empty if unknown
+vector<int> GetAllowedCpus() {
+    vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpu_set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+vector<NumaNode> ReadSysfsNodes(const vector<int>& allowed_cpus) {
+    vector<NumaNode> nodes;
+    const filesystem::path root = "/sys/devices/system/node";
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(root, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0
+            || !all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        ifstream input(entry.path() / "cpulist");
+        string cpu_list;
+        if (!getline(input, cpu_list)) {
+            continue;
+        }
+        NumaNode node{ParseCpuNumber(string_view(name).substr(4)), {}};
+        for (const int cpu : ParseCpuList(cpu_list)) {
+            if (allowed_cpus.empty() || binary_search(allowed_cpus.begin(), allowed_cpus.end(), cpu)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        // Memory-only nodes and nodes outside the affinity mask run no workers
+        if (!node.cpus.empty()) {
+            nodes.push_back(move(node));
+        }
+    }
+    sort(nodes.begin(), nodes.end(), [](const NumaNode& lhs, const NumaNode& rhs) {
+        return lhs.id < rhs.id;
+    });
+    return nodes;
+}
+
+} // namespace
+
+vector<int> ParseCpuList(string_view text) {
+    vector<int> cpus;
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.remove_suffix(1);
+    }
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        const string_view range = text.substr(0, comma);
+        const size_t dash = range.find('-');
+        const int first = ParseCpuNumber(range.substr(0, dash));
+        const int last = dash == string_view::npos ? first : ParseCpuNumber(range.substr(dash + 1));
+        if (last < first) {
+            throw invalid_argument("Invalid CPU list"s);
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        text.remove_prefix(comma == string_view::npos ? text.size() : comma + 1);
+    }
+    return cpus;
+}
+
+vector<NumaNode> DetectNumaNodes() {
+    vector<int> allowed_cpus = GetAllowedCpus();
+    vector<NumaNode> nodes = ReadSysfsNodes(allowed_cpus);
+    if (!nodes.empty()) {
+        return nodes;
+    }
+    if (allowed_cpus.empty()) {
+        for (unsigned cpu = 0; cpu < max(1u, thread::hardware_concurrency()); ++cpu) {
+            allowed_cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return {NumaNode{0, move(allowed_cpus)}};
+}
+
+bool PinCurrentThread(const vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+    return CPU_COUNT(&cpu_set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+NodeWorkerPool::NodeWorkerPool(const NumaNode& node, size_t queue_capacity)
+    : node_(node)
+    , tasks_(queue_capacity) {
+    const size_t worker_count = max<size_t>(1, node_.cpus.size());
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] {
+            // Unpinned workers still run the tasks, only without locality
+            PinCurrentThread(node_.cpus);
+            while (auto task = tasks_.Pop()) {
+                (*task)();
+            }
+        });
+    }
+}
+
+NodeWorkerPool::~NodeWorkerPool() {
+    tasks_.Close();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+const NumaNode& NodeWorkerPool::GetNode() const {
+    return node_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bounded_queue.h"
+
+/*
+    NUMA topology without libnuma.
+
+    Nodes and their CPUs come from /sys/devices/system/node on Linux, restricted to the CPUs
+    the process may run on. Elsewhere, or when sysfs is unavailable, the machine is one node.
+    Memory is placed by the kernel's first-touch policy: pages land on the node of the thread
+    that first writes them, so data built by a thread pinned to a node stays on that node.
+*/
+
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// Nodes with at least one usable CPU, ordered by id; never empty
+std::vector<NumaNode> DetectNumaNodes();
+
+// Parses a kernel CPU list such as "0-3,8,10-11"; throws invalid_argument if malformed
+std::vector<int> ParseCpuList(std::string_view text);
+
+// Restricts the calling thread to cpus; false where affinity is not supported or refused
+bool PinCurrentThread(const std::vector<int>& cpus);
+
+// Worker threads pinned to the CPUs of one node, one per CPU. Tasks run in submission order
+// on whichever worker is free; Submit waits while queue_capacity tasks are pending.
+class NodeWorkerPool {
+public:
+    explicit NodeWorkerPool(const NumaNode& node, size_t queue_capacity = 1024);
+    // Runs the pending tasks and joins the workers
+    ~NodeWorkerPool();
+
+    NodeWorkerPool(const NodeWorkerPool&) = delete;
+    NodeWorkerPool& operator=(const NodeWorkerPool&) = delete;
+
+    const NumaNode& GetNode() const;
+
+    // The future holds the result of task() or the exception it threw
+    template <typename Task>
+    std::future<std::invoke_result_t<Task>> Submit(Task task);
+
+private:
+    NumaNode node_;
+    BoundedQueue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+};
+
+template <typename Task>
+std::future<std::invoke_result_t<Task>> NodeWorkerPool::Submit(Task task) {
+    // std::function needs a copyable target, packaged_task is move-only
+    auto packaged_task = std::make_shared<std::packaged_task<std::invoke_result_t<Task>()>>(std::move(task));
+    auto result = packaged_task->get_future();
+    if (!tasks_.Push([packaged_task] { (*packaged_task)(); })) {
+        throw std::logic_error("Worker pool is stopped");
+    }
+    return result;
+}
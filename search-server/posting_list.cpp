@@ -0,0 +1,172 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Above this length ratio galloping beats a linear merge
+constexpr size_t GALLOP_LENGTH_RATIO = 32;
+
+void IntersectGalloping(const vector<int>& shorter, const vector<int>& longer, vector<int>& result) {
+    size_t position = 0;
+    for (const int document_id : shorter) {
+        position = GallopLowerBound(longer, position, document_id);
+        if (position == longer.size()) {
+            break;
+        }
+        if (longer[position] == document_id) {
+            result.push_back(document_id);
+        }
+    }
+}
+
+void IntersectMerging(const vector<int>& lhs, const vector<int>& rhs, vector<int>& result) {
+    size_t i = 0;
+    size_t j = 0;
+#if defined(__SSE2__)
+    // Compares blocks of 4 ids with all 4 rotations of the other block
+    while (i + 4 <= lhs.size() && j + 4 <= rhs.size()) {
+        const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs.data() + i));
+        const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs.data() + j));
+        __m128i equal = _mm_cmpeq_epi32(lhs_block, rhs_block);
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(2, 1, 0, 3))));
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        for (int k = 0; k < 4; ++k) {
+            if (mask & (1 << k)) {
+                result.push_back(lhs[i + k]);
+            }
+        }
+        const int lhs_max = lhs[i + 3];
+        const int rhs_max = rhs[j + 3];
+        if (lhs_max <= rhs_max) {
+            i += 4;
+        }
+        if (rhs_max <= lhs_max) {
+            j += 4;
+        }
+    }
+#endif
+    while (i < lhs.size() && j < rhs.size()) {
+        if (lhs[i] < rhs[j]) {
+            ++i;
+        } else if (rhs[j] < lhs[i]) {
+            ++j;
+        } else {
+            result.push_back(lhs[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+} // namespace
+
+void PostingList::Add(int document_id, double term_freq) {
+    if (document_ids_.empty() || document_ids_.back() < document_id) {
+        document_ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+        return;
+    }
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    const auto index = it - document_ids_.begin();
+    if (*it == document_id) {
+        term_freqs_[index] += term_freq;
+    } else {
+        document_ids_.insert(it, document_id);
+        term_freqs_.insert(term_freqs_.begin() + index, term_freq);
+    }
+}
+
+void PostingList::Erase(int document_id) {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return;
+    }
+    term_freqs_.erase(term_freqs_.begin() + (it - document_ids_.begin()));
+    document_ids_.erase(it);
+}
+
+void PostingList::Renumber(const vector<int>& new_ids) {
+    vector<pair<int, double>> postings(document_ids_.size());
+    for (size_t i = 0; i < postings.size(); ++i) {
+        postings[i] = {new_ids[document_ids_[i]], term_freqs_[i]};
+    }
+    sort(postings.begin(), postings.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    for (size_t i = 0; i < postings.size(); ++i) {
+        document_ids_[i] = postings[i].first;
+        term_freqs_[i] = postings[i].second;
+    }
+}
+
+size_t PostingList::size() const {
+    return document_ids_.size();
+}
+
+bool PostingList::empty() const {
+    return document_ids_.empty();
+}
+
+const vector<int>& PostingList::GetDocumentIds() const {
+    return document_ids_;
+}
+
+const vector<double>& PostingList::GetTermFreqs() const {
+    return term_freqs_;
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return sizeof(*this) + document_ids_.capacity() * sizeof(int) + term_freqs_.capacity() * sizeof(double);
+}
+
+size_t PostingList::GetEncodedSize() const {
+    size_t result = 0;
+    int previous_id = -1;
+    for (const int document_id : document_ids_) {
+        // 7 bits per byte
+        for (auto gap = static_cast<uint32_t>(document_id - previous_id); ; gap >>= 7) {
+            ++result;
+            if (gap < 128) {
+                break;
+            }
+        }
+        previous_id = document_id;
+    }
+    return result;
+}
+
+size_t GallopLowerBound(const vector<int>& ids, size_t first, int value) {
+    size_t step = 1;
+    size_t left = first;
+    size_t right = first;
+    while (right < ids.size() && ids[right] < value) {
+        left = right + 1;
+        right = min(right + step, ids.size());
+        step *= 2;
+    }
+    return lower_bound(ids.begin() + left, ids.begin() + right, value) - ids.begin();
+}
+
+vector<int> IntersectDocumentIds(const vector<int>& lhs, const vector<int>& rhs) {
+    const vector<int>& shorter = lhs.size() <= rhs.size() ? lhs : rhs;
+    const vector<int>& longer = lhs.size() <= rhs.size() ? rhs : lhs;
+    vector<int> result;
+    result.reserve(shorter.size());
+    if (shorter.size() * GALLOP_LENGTH_RATIO < longer.size()) {
+        IntersectGalloping(shorter, longer, result);
+    } else {
+        IntersectMerging(shorter, longer, result);
+    }
+    return result;
+}
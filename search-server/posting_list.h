@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Documents containing a word: ids sorted ascending, term frequencies in a parallel array.
+// Appending a larger id is amortized O(1); inserting or erasing in the middle moves the tail.
+class PostingList {
+public:
+    // Adds term_freq to the frequency of document_id, inserting it if absent
+    void Add(int document_id, double term_freq);
+    void Erase(int document_id);
+
+    // Replaces every id with new_ids[id] and restores the id order
+    void Renumber(const std::vector<int>& new_ids);
+
+    size_t size() const;
+    bool empty() const;
+
+    const std::vector<int>& GetDocumentIds() const;
+    const std::vector<double>& GetTermFreqs() const;
+
+    size_t GetMemoryUsage() const;
+
+    // Bytes the ids would take as varint-coded gaps, the usual compressed layout
+    size_t GetEncodedSize() const;
+
+private:
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+};
+
+// First index in [first, ids.size()) with ids[index] >= value.
+// Gallops from first, so a scan of increasing values costs O(log gap) per step.
+size_t GallopLowerBound(const std::vector<int>& ids, size_t first, int value);
+
+// Intersection of two sorted arrays of unique ids.
+// Galloping search when one array is much shorter, SIMD block comparison otherwise.
+std::vector<int> IntersectDocumentIds(const std::vector<int>& lhs, const std::vector<int>& rhs);
@@ -0,0 +1,135 @@
+#include "query_log.h"
+
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+constexpr string_view QUERY_LOG_MAGIC = "SSQLOG01"sv;
+constexpr size_t SIZE_FIELD_BYTES = 4;
+// Fixed fields of a record after the size: timestamp, latency, kind, status, query length, count
+constexpr size_t RECORD_FIXED_BYTES = 8 + 8 + 1 + 1 + 4 + 4;
+
+void AppendUint(string& out, uint64_t value, int byte_count) {
+    for (int i = 0; i < byte_count; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t ReadUint(string_view& data, int byte_count) {
+    if (data.size() < static_cast<size_t>(byte_count)) {
+        throw QueryLogError("Truncated query log record"s);
+    }
+    uint64_t value = 0;
+    for (int i = byte_count - 1; i >= 0; --i) {
+        value = (value << 8) | static_cast<uint8_t>(data[i]);
+    }
+    data.remove_prefix(byte_count);
+    return value;
+}
+
+QueryLogRecord ParseRecord(string_view data) {
+    QueryLogRecord record;
+    record.timestamp_us = static_cast<int64_t>(ReadUint(data, 8));
+    record.latency_ns = ReadUint(data, 8);
+    const uint8_t kind = static_cast<uint8_t>(ReadUint(data, 1));
+    const uint8_t status = static_cast<uint8_t>(ReadUint(data, 1));
+    if (kind > static_cast<uint8_t>(QueryLogKind::PREDICATE) || status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw QueryLogError("Unknown kind or status in query log record"s);
+    }
+    record.kind = static_cast<QueryLogKind>(kind);
+    record.status = static_cast<DocumentStatus>(status);
+    const size_t query_size = ReadUint(data, 4);
+    if (query_size > data.size()) {
+        throw QueryLogError("Truncated query log record"s);
+    }
+    record.raw_query = string(data.substr(0, query_size));
+    data.remove_prefix(query_size);
+    const size_t count = ReadUint(data, 4);
+    if (count != data.size() / 4 || data.size() % 4 != 0) {
+        throw QueryLogError("Result count does not match the query log record size"s);
+    }
+    record.document_ids.resize(count);
+    for (int& document_id : record.document_ids) {
+        document_id = static_cast<int>(ReadUint(data, 4));
+    }
+    return record;
+}
+
+} // namespace
+
+QueryLogWriter::QueryLogWriter(const string& path)
+    : output_(path, ios::binary | ios::trunc)
+    , full_blocks_(4) {
+    if (!output_) {
+        throw QueryLogError("Cannot open "s + path);
+    }
+    output_ << QUERY_LOG_MAGIC;
+    block_.reserve(BLOCK_SIZE);
+    output_thread_ = thread([this] {
+        while (auto block = full_blocks_.Pop()) {
+            output_.write(block->data(), block->size());
+        }
+        output_.flush();
+    });
+}
+
+QueryLogWriter::~QueryLogWriter() {
+    {
+        lock_guard guard(mutex_);
+        if (!block_.empty()) {
+            full_blocks_.Push(move(block_));
+        }
+    }
+    full_blocks_.Close();
+    output_thread_.join();
+}
+
+void QueryLogWriter::Write(int64_t timestamp_us, uint64_t latency_ns, QueryLogKind kind, DocumentStatus status,
+                           string_view raw_query, const vector<Document>& documents) {
+    lock_guard guard(mutex_);
+    AppendUint(block_, RECORD_FIXED_BYTES + raw_query.size() + 4 * documents.size(), SIZE_FIELD_BYTES);
+    AppendUint(block_, static_cast<uint64_t>(timestamp_us), 8);
+    AppendUint(block_, latency_ns, 8);
+    AppendUint(block_, static_cast<uint8_t>(kind), 1);
+    AppendUint(block_, static_cast<uint8_t>(status), 1);
+    AppendUint(block_, raw_query.size(), 4);
+    block_.append(raw_query);
+    AppendUint(block_, documents.size(), 4);
+    for (const Document& document : documents) {
+        AppendUint(block_, static_cast<uint32_t>(document.id), 4);
+    }
+    if (block_.size() >= BLOCK_SIZE) {
+        full_blocks_.Push(move(block_));
+        block_.clear();
+        block_.reserve(BLOCK_SIZE);
+    }
+}
+
+vector<QueryLogRecord> ReadQueryLog(istream& input) {
+    const string data{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+    string_view rest = data;
+    if (rest.substr(0, QUERY_LOG_MAGIC.size()) != QUERY_LOG_MAGIC) {
+        throw QueryLogError("Not a query log"s);
+    }
+    rest.remove_prefix(QUERY_LOG_MAGIC.size());
+    vector<QueryLogRecord> records;
+    while (!rest.empty()) {
+        const size_t size = ReadUint(rest, SIZE_FIELD_BYTES);
+        if (size > rest.size()) {
+            throw QueryLogError("Truncated query log record"s);
+        }
+        records.push_back(ParseRecord(rest.substr(0, size)));
+        rest.remove_prefix(size);
+    }
+    return records;
+}
+
+vector<QueryLogRecord> ReadQueryLog(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw QueryLogError("Cannot open "s + path);
+    }
+    return ReadQueryLog(input);
+}
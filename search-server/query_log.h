@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "document.h"
+
+/*
+    Binary query log written by RequestQueue and read by search-server-replay.
+
+    The file starts with the 8 bytes "SSQLOG01", followed by records. A record is a uint32
+    size of the rest of the record, then
+        int64 timestamp (system clock, microseconds since the epoch),
+        uint64 latency in nanoseconds, uint8 kind, uint8 document status,
+        uint32 length and bytes of the raw query, uint32 n, n x int32 result document id.
+    Integers are little-endian, as in search_protocol.h.
+*/
+
+// How the request selected documents
+enum class QueryLogKind : uint8_t {
+    // By document status, which the record keeps
+    STATUS = 0,
+    // By a predicate, which cannot be logged: replays fall back to ACTUAL documents
+    PREDICATE = 1,
+};
+
+struct QueryLogRecord {
+    int64_t timestamp_us = 0;
+    uint64_t latency_ns = 0;
+    QueryLogKind kind = QueryLogKind::STATUS;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::string raw_query;
+    // Result in rank order
+    std::vector<int> document_ids;
+};
+
+// Thrown for a file that is not a query log or ends mid-record
+class QueryLogError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Appends records to a log file. Write only encodes the record into a memory block;
+// full blocks go to a background thread that writes them, so the caller never waits for
+// the disk unless several blocks are queued. Safe to call from several threads.
+class QueryLogWriter {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 << 10;
+
+    // Truncates the file; throws QueryLogError if it cannot be opened
+    explicit QueryLogWriter(const std::string& path);
+    // Writes the last block and waits for the background thread
+    ~QueryLogWriter();
+
+    QueryLogWriter(const QueryLogWriter&) = delete;
+    QueryLogWriter& operator=(const QueryLogWriter&) = delete;
+
+    void Write(int64_t timestamp_us, uint64_t latency_ns, QueryLogKind kind, DocumentStatus status,
+               std::string_view raw_query, const std::vector<Document>& documents);
+
+private:
+    std::ofstream output_;
+    std::mutex mutex_;
+    std::string block_;
+    BoundedQueue<std::string> full_blocks_;
+    std::thread output_thread_;
+};
+
+// Throws QueryLogError for malformed input
+std::vector<QueryLogRecord> ReadQueryLog(std::istream& input);
+std::vector<QueryLogRecord> ReadQueryLog(const std::string& path);
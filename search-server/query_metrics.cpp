@@ -0,0 +1,199 @@
+#include "query_metrics.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(QueryStage::COUNT);
+
+// Written only by the owning thread, read by Snapshot
+struct ThreadMetrics {
+    atomic<uint64_t> queries{};
+    atomic<uint64_t> postings_scanned{};
+    array<array<atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>, STAGE_COUNT> stage_buckets{};
+    array<atomic<uint64_t>, STAGE_COUNT> stage_sums{};
+};
+
+// A single writer needs no read-modify-write instruction
+void Increase(atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+struct ThreadMetricsRegistry {
+    mutex guard;
+    // Metrics of finished threads stay to keep the totals
+    vector<unique_ptr<ThreadMetrics>> threads;
+};
+
+ThreadMetricsRegistry& GetRegistry() {
+    static ThreadMetricsRegistry registry;
+    return registry;
+}
+
+ThreadMetrics& GetThreadMetrics() {
+    thread_local ThreadMetrics* const metrics = [] {
+        auto& registry = GetRegistry();
+        lock_guard lock(registry.guard);
+        registry.threads.push_back(make_unique<ThreadMetrics>());
+        return registry.threads.back().get();
+    }();
+    return *metrics;
+}
+
+} // namespace
+
+const char* GetQueryStageName(QueryStage stage) {
+    switch (stage) {
+        case QueryStage::PARSE: return "parse";
+        case QueryStage::POSTING_SCAN: return "posting_scan";
+        case QueryStage::MINUS_WORDS: return "minus_words";
+        case QueryStage::SORT: return "sort";
+        case QueryStage::RESULT_BUILD: return "result_build";
+        case QueryStage::COUNT: break;
+    }
+    return "unknown";
+}
+
+int LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<int>(value);
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const int shift = exponent - SUB_BUCKET_BITS;
+    const int sub_bucket = static_cast<int>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+    return SUB_BUCKET_COUNT * (shift + 1) + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    return (SUB_BUCKET_COUNT + sub_bucket) << shift;
+}
+
+void LatencyHistogram::Add(uint64_t value) {
+    ++buckets[GetBucketIndex(value)];
+    sum += value;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    uint64_t count = 0;
+    for (const uint64_t bucket : buckets) {
+        count += bucket;
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::GetSum() const {
+    return sum;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const {
+    const uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = min(count, static_cast<uint64_t>(fraction * count) + 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return GetBucketLowerBound(i);
+        }
+    }
+    return GetBucketLowerBound(BUCKET_COUNT - 1);
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    sum += other.sum;
+    return *this;
+}
+
+ostream& operator<<(ostream& out, const QueryMetricsSnapshot& snapshot) {
+    out << "{\"queries\":"s << snapshot.queries
+        << ",\"postings_scanned\":"s << snapshot.postings_scanned
+        << ",\"stages\":{"s;
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const auto& histogram = snapshot.stages[i];
+        if (i > 0) {
+            out << ',';
+        }
+        out << '"' << GetQueryStageName(static_cast<QueryStage>(i)) << "\":{"s
+            << "\"count\":"s << histogram.GetCount()
+            << ",\"sum_ns\":"s << histogram.GetSum()
+            << ",\"p50_ns\":"s << histogram.GetPercentile(0.5)
+            << ",\"p99_ns\":"s << histogram.GetPercentile(0.99)
+            << ",\"p999_ns\":"s << histogram.GetPercentile(0.999)
+            << '}';
+    }
+    return out << "}}"s;
+}
+
+atomic<bool> QueryMetrics::enabled_{false};
+
+void QueryMetrics::SetEnabled(bool enabled) {
+    enabled_.store(enabled, memory_order_relaxed);
+}
+
+void QueryMetrics::RecordStage(QueryStage stage, chrono::steady_clock::duration duration) {
+    const uint64_t nanoseconds = chrono::duration_cast<chrono::nanoseconds>(duration).count();
+    auto& metrics = GetThreadMetrics();
+    const size_t stage_index = static_cast<size_t>(stage);
+    Increase(metrics.stage_buckets[stage_index][LatencyHistogram::GetBucketIndex(nanoseconds)], 1);
+    Increase(metrics.stage_sums[stage_index], nanoseconds);
+}
+
+void QueryMetrics::AddPostingsScanned(uint64_t count) {
+    if (IsEnabled()) {
+        Increase(GetThreadMetrics().postings_scanned, count);
+    }
+}
+
+void QueryMetrics::AddQuery() {
+    if (IsEnabled()) {
+        Increase(GetThreadMetrics().queries, 1);
+    }
+}
+
+QueryMetricsSnapshot QueryMetrics::Snapshot() {
+    QueryMetricsSnapshot snapshot;
+    auto& registry = GetRegistry();
+    lock_guard lock(registry.guard);
+    for (const auto& metrics : registry.threads) {
+        snapshot.queries += metrics->queries.load(memory_order_relaxed);
+        snapshot.postings_scanned += metrics->postings_scanned.load(memory_order_relaxed);
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            auto& histogram = snapshot.stages[stage];
+            for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+                histogram.buckets[i] += metrics->stage_buckets[stage][i].load(memory_order_relaxed);
+            }
+            histogram.sum += metrics->stage_sums[stage].load(memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+// Updates racing with Reset may survive it
+void QueryMetrics::Reset() {
+    auto& registry = GetRegistry();
+    lock_guard lock(registry.guard);
+    for (const auto& metrics : registry.threads) {
+        metrics->queries.store(0, memory_order_relaxed);
+        metrics->postings_scanned.store(0, memory_order_relaxed);
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            for (auto& bucket : metrics->stage_buckets[stage]) {
+                bucket.store(0, memory_order_relaxed);
+            }
+            metrics->stage_sums[stage].store(0, memory_order_relaxed);
+        }
+    }
+}
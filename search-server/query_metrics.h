@@ -0,0 +1,115 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#define QUERY_METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define QUERY_METRICS_CONCAT(X, Y) QUERY_METRICS_CONCAT_INTERNAL(X, Y)
+
+/**
+ * Замеряет время от вызова макроса до конца блока и добавляет его
+ * в гистограмму этапа запроса, если сбор метрик включён.
+ *
+ *  {
+ *      QUERY_STAGE(QueryStage::PARSE);
+ *      query = ParseQuery(raw_query);
+ *  }
+ */
+#define QUERY_STAGE(stage) QueryStageTimer QUERY_METRICS_CONCAT(queryStageTimer, __LINE__)(stage)
+
+enum class QueryStage {
+    PARSE,
+    POSTING_SCAN,
+    MINUS_WORDS,
+    SORT,
+    RESULT_BUILD,
+    COUNT,
+};
+
+const char* GetQueryStageName(QueryStage stage);
+
+// Log-linear latency histogram: 8 buckets per power of two, so every bucket
+// is within 12.5% of the recorded value
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKET_COUNT = SUB_BUCKET_COUNT * (64 - SUB_BUCKET_BITS + 1);
+
+    static int GetBucketIndex(uint64_t value);
+    // Smallest value that falls into the bucket
+    static uint64_t GetBucketLowerBound(int index);
+
+    void Add(uint64_t value);
+
+    uint64_t GetCount() const;
+    uint64_t GetSum() const;
+    // Lower bound of the bucket holding the given fraction of values, 0 if empty
+    uint64_t GetPercentile(double fraction) const;
+
+    LatencyHistogram& operator+=(const LatencyHistogram& other);
+
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+    uint64_t sum = 0;
+};
+
+struct QueryMetricsSnapshot {
+    uint64_t queries = 0;
+    uint64_t postings_scanned = 0;
+    // Nanoseconds per stage
+    std::array<LatencyHistogram, static_cast<size_t>(QueryStage::COUNT)> stages;
+};
+
+// Prints the snapshot as one JSON object
+std::ostream& operator<<(std::ostream& out, const QueryMetricsSnapshot& snapshot);
+
+// Process-wide query metrics.
+// Every thread writes only to its own counters with relaxed atomics, so recording
+// takes no locks; Snapshot sums the counters of all threads.
+class QueryMetrics {
+public:
+    static void SetEnabled(bool enabled);
+
+    static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static void RecordStage(QueryStage stage, std::chrono::steady_clock::duration duration);
+    static void AddPostingsScanned(uint64_t count);
+    static void AddQuery();
+
+    static QueryMetricsSnapshot Snapshot();
+    static void Reset();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class QueryStageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStageTimer(QueryStage stage)
+        : stage_(stage)
+        , is_enabled_(QueryMetrics::IsEnabled()) {
+        if (is_enabled_) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    ~QueryStageTimer() {
+        if (is_enabled_) {
+            QueryMetrics::RecordStage(stage_, Clock::now() - start_time_);
+        }
+    }
+
+    QueryStageTimer(const QueryStageTimer&) = delete;
+    QueryStageTimer& operator=(const QueryStageTimer&) = delete;
+
+private:
+    const QueryStage stage_;
+    const bool is_enabled_;
+    Clock::time_point start_time_;
+};
@@ -0,0 +1,186 @@
+// Replays a query log captured by RequestQueue::SetQueryLog against an index snapshot.
+//
+// Requests are issued at their original pace multiplied by --rate (0: as fast as possible)
+// from --threads workers. Latency counts from the moment a request was due, so a server
+// that falls behind the log shows it. Prints one JSON line with latency percentiles of the
+// replay and of the capture, and the number of requests whose result differs from the
+// logged one; the first --diffs of them are printed to stderr.
+//
+// Usage: search-server-replay --index file --log file [--stop-words "a the"]
+//                             [--rate X] [--threads N] [--diffs N]
+//
+// Index file: TSV or JSONL corpus, see corpus_loader.h.
+
+#include "corpus_loader.h"
+#include "query_log.h"
+#include "query_metrics.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct ReplayConfig {
+    string index_path;
+    string log_path;
+    string stop_words;
+    double rate = 1.0;
+    int thread_count = 1;
+    int printed_diff_count = 10;
+};
+
+struct ReplayResult {
+    // From the due time, and of the search alone
+    LatencyHistogram latencies;
+    LatencyHistogram service_times;
+};
+
+vector<Document> Replay(const SearchServer& search_server, const QueryLogRecord& record) {
+    // A predicate cannot be logged: such requests are replayed for load only
+    const DocumentStatus status = record.kind == QueryLogKind::STATUS ? record.status : DocumentStatus::ACTUAL;
+    return search_server.FindTopDocuments(execution::seq, record.raw_query, status);
+}
+
+void PrintDiff(const QueryLogRecord& record, const vector<int>& document_ids) {
+    auto print_ids = [](const vector<int>& ids) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            cerr << (i == 0 ? ""sv : " "sv) << ids[i];
+        }
+    };
+    cerr << record.raw_query << "\tlogged: "sv;
+    print_ids(record.document_ids);
+    cerr << "\treplayed: "sv;
+    print_ids(document_ids);
+    cerr << endl;
+}
+
+ReplayConfig ParseArguments(int argc, char** argv) {
+    ReplayConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--index"sv) {
+            config.index_path = value;
+        } else if (name == "--log"sv) {
+            config.log_path = value;
+        } else if (name == "--stop-words"sv) {
+            config.stop_words = value;
+        } else if (name == "--rate"sv) {
+            config.rate = stod(value);
+        } else if (name == "--threads"sv) {
+            config.thread_count = stoi(value);
+        } else if (name == "--diffs"sv) {
+            config.printed_diff_count = stoi(value);
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (config.index_path.empty() || config.log_path.empty()) {
+        throw invalid_argument("--index and --log are required"s);
+    }
+    if (config.rate < 0 || config.thread_count <= 0) {
+        throw invalid_argument("Rate must be non-negative and thread count positive"s);
+    }
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const ReplayConfig config = ParseArguments(argc, argv);
+        const vector<QueryLogRecord> records = ReadQueryLog(config.log_path);
+        if (records.empty()) {
+            throw invalid_argument("No records in "s + config.log_path);
+        }
+        SearchServer search_server(config.stop_words);
+        const CorpusLoadStats load_stats = LoadCorpus(search_server, config.index_path);
+        cerr << "Loaded "s << load_stats.document_count << " documents, replaying "s << records.size() << " requests"s << endl;
+
+        // Workers take requests in log order and wait for their due time
+        vector<vector<int>> replayed_ids(records.size());
+        vector<ReplayResult> results(config.thread_count);
+        atomic<size_t> next_record = 0;
+        const auto start_time = Clock::now();
+        auto get_due_time = [&](const QueryLogRecord& record) {
+            if (config.rate == 0) {
+                return Clock::now();
+            }
+            const chrono::duration<double, micro> offset((record.timestamp_us - records.front().timestamp_us) / config.rate);
+            return start_time + chrono::duration_cast<Clock::duration>(offset);
+        };
+        vector<thread> threads;
+        for (int t = 0; t < config.thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                for (size_t index; (index = next_record.fetch_add(1)) < records.size();) {
+                    const auto due_time = get_due_time(records[index]);
+                    this_thread::sleep_until(due_time);
+                    const auto search_start = Clock::now();
+                    for (const Document& document : Replay(search_server, records[index])) {
+                        replayed_ids[index].push_back(document.id);
+                    }
+                    const auto end_time = Clock::now();
+                    results[t].latencies.Add(chrono::duration_cast<chrono::nanoseconds>(end_time - due_time).count());
+                    results[t].service_times.Add(chrono::duration_cast<chrono::nanoseconds>(end_time - search_start).count());
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start_time).count();
+
+        ReplayResult total;
+        for (const ReplayResult& result : results) {
+            total.latencies += result.latencies;
+            total.service_times += result.service_times;
+        }
+        LatencyHistogram logged_latencies;
+        size_t diff_count = 0;
+        size_t uncompared_count = 0;
+        for (size_t i = 0; i < records.size(); ++i) {
+            logged_latencies.Add(records[i].latency_ns);
+            if (records[i].kind == QueryLogKind::PREDICATE) {
+                ++uncompared_count;
+            } else if (replayed_ids[i] != records[i].document_ids) {
+                if (static_cast<int>(diff_count) < config.printed_diff_count) {
+                    PrintDiff(records[i], replayed_ids[i]);
+                }
+                ++diff_count;
+            }
+        }
+        cout << "{\"requests\":"s << records.size()
+             << ",\"threads\":"s << config.thread_count
+             << ",\"rate\":"s << config.rate
+             << ",\"seconds\":"s << seconds
+             << ",\"qps\":"s << records.size() / seconds
+             << ",\"p50_us\":"s << total.latencies.GetPercentile(0.5) / 1000.0
+             << ",\"p99_us\":"s << total.latencies.GetPercentile(0.99) / 1000.0
+             << ",\"p999_us\":"s << total.latencies.GetPercentile(0.999) / 1000.0
+             << ",\"service_p50_us\":"s << total.service_times.GetPercentile(0.5) / 1000.0
+             << ",\"service_p99_us\":"s << total.service_times.GetPercentile(0.99) / 1000.0
+             << ",\"logged_p50_us\":"s << logged_latencies.GetPercentile(0.5) / 1000.0
+             << ",\"logged_p99_us\":"s << logged_latencies.GetPercentile(0.99) / 1000.0
+             << ",\"result_diffs\":"s << diff_count
+             << ",\"not_compared\":"s << uncompared_count
+             << '}' << endl;
+    } catch (const exception& e) {
+        cerr << "Replay failed: "s << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "remove_duplicates.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+constexpr int MINHASH_BAND_COUNT = 16;
+constexpr int MINHASH_BAND_ROWS = 4;
+constexpr int MINHASH_SIZE = MINHASH_BAND_COUNT * MINHASH_BAND_ROWS;
+
+using MinHashSignature = array<uint64_t, MINHASH_SIZE>;
+
+// splitmix64 finalizer
+uint64_t MixHash(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+using DocumentWords = vector<string_view>;
+
+uint64_t ComputeWordSetHash(const DocumentWords& words) {
+    uint64_t hash = words.size();
+    for (const string_view word : words) {
+        hash = MixHash(hash ^ std::hash<string_view>{}(word));
+    }
+    return hash;
+}
+
+double ComputeJaccardSimilarity(const DocumentWords& lhs, const DocumentWords& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        } else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
+        } else {
+            ++common;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common) / (lhs.size() + rhs.size() - common);
+}
+
+MinHashSignature ComputeMinHashSignature(const DocumentWords& words) {
+    MinHashSignature signature;
+    signature.fill(UINT64_MAX);
+    for (const string_view word : words) {
+        const uint64_t word_hash = std::hash<string_view>{}(word);
+        for (int i = 0; i < MINHASH_SIZE; ++i) {
+            signature[i] = min(signature[i], MixHash(word_hash + i * 0x632be59bd9b4e019ULL));
+        }
+    }
+    return signature;
+}
+
+void RemoveDocuments(SearchServer& search_server, const vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        cout << "Found duplicate document id "s << document_id << endl;
+        search_server.RemoveDocument(document_id);
+    }
+}
+
+} // namespace
+
+void RemoveDuplicates(SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    const vector<DocumentWords> document_words = search_server.GetDocumentWords();
+    // Hashes and positions in document_ids
+    vector<pair<uint64_t, size_t>> hash_to_id(document_ids.size());
+    transform(execution::par, document_words.begin(), document_words.end(), hash_to_id.begin(),
+        [&document_words](const DocumentWords& words) {
+            return pair{ComputeWordSetHash(words), static_cast<size_t>(&words - document_words.data())};
+        });
+    // Groups of equal hashes, ids ascending inside each group
+    sort(execution::par, hash_to_id.begin(), hash_to_id.end());
+
+    vector<int> duplicates;
+    vector<size_t> originals;
+    for (size_t group_begin = 0; group_begin < hash_to_id.size();) {
+        size_t group_end = group_begin + 1;
+        while (group_end < hash_to_id.size() && hash_to_id[group_end].first == hash_to_id[group_begin].first) {
+            ++group_end;
+        }
+        // Documents sharing a hash almost always share words, still compare to rule out collisions
+        originals.clear();
+        for (size_t i = group_begin; i < group_end; ++i) {
+            const size_t position = hash_to_id[i].second;
+            const bool is_duplicate = any_of(originals.begin(), originals.end(), [&](size_t original) {
+                return document_words[original] == document_words[position];
+            });
+            if (is_duplicate) {
+                duplicates.push_back(document_ids[position]);
+            } else {
+                originals.push_back(position);
+            }
+        }
+        group_begin = group_end;
+    }
+    sort(duplicates.begin(), duplicates.end());
+    RemoveDocuments(search_server, duplicates);
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold) {
+    if (similarity_threshold <= 0.0 || similarity_threshold > 1.0) {
+        throw invalid_argument("Similarity threshold must be in (0, 1]"s);
+    }
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    const vector<DocumentWords> document_words = search_server.GetDocumentWords();
+    vector<MinHashSignature> signatures(document_ids.size());
+    transform(execution::par, document_words.begin(), document_words.end(), signatures.begin(), ComputeMinHashSignature);
+
+    // Documents are candidates when all rows of at least one band coincide. Every band bucket
+    // keeps one representative, its first document left in the index; later documents of the
+    // bucket are checked against it alone, so a bucket of k documents costs O(k).
+    vector<unordered_map<uint64_t, size_t>> band_representatives(MINHASH_BAND_COUNT);
+    vector<int> duplicates;
+    array<uint64_t, MINHASH_BAND_COUNT> band_hashes;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        bool is_duplicate = false;
+        for (int band = 0; band < MINHASH_BAND_COUNT; ++band) {
+            uint64_t band_hash = band;
+            for (int row = 0; row < MINHASH_BAND_ROWS; ++row) {
+                band_hash = MixHash(band_hash ^ signatures[i][band * MINHASH_BAND_ROWS + row]);
+            }
+            band_hashes[band] = band_hash;
+            const auto it = band_representatives[band].find(band_hash);
+            if (it != band_representatives[band].end()
+                && ComputeJaccardSimilarity(document_words[it->second], document_words[i]) >= similarity_threshold) {
+                is_duplicate = true;
+                break;
+            }
+        }
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[i]);
+            continue;
+        }
+        for (int band = 0; band < MINHASH_BAND_COUNT; ++band) {
+            band_representatives[band].emplace(band_hashes[band], i);
+        }
+    }
+    RemoveDocuments(search_server, duplicates);
+}
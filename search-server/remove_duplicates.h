@@ -0,0 +1,12 @@
+#pragma once
+#include "search_server.h"
+
+// Removes documents with the same set of words as a document with a lower id.
+// Word sets are hashed in one parallel pass, only documents with equal hashes are compared.
+void RemoveDuplicates(SearchServer& search_server);
+
+// Also removes near-duplicates: documents whose word sets have Jaccard similarity
+// of at least similarity_threshold with a document with a lower id.
+// Candidates are found with MinHash signatures and LSH banding, then checked exactly against
+// the first kept document of each shared band bucket, so the pass stays linear in the documents.
+void RemoveNearDuplicates(SearchServer& search_server, double similarity_threshold);
@@ -7,9 +7,9 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int, DocumentStatus document_status, int){
+    return AddRequest(raw_query, [status](int, DocumentStatus document_status, int){
         return status == document_status;
-    });
+    }, QueryLogKind::STATUS, status);
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
@@ -20,3 +20,7 @@ int RequestQueue::GetNoResultRequests() const {
     return no_result_requests_count_;
 }
 
+void RequestQueue::SetQueryLog(QueryLogWriter* query_log) {
+    query_log_ = query_log;
+}
+
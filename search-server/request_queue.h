@@ -1,6 +1,8 @@
 #pragma once
 #include "search_server.h"
 #include "document.h"
+#include "query_log.h"
+#include <chrono>
 #include <vector>
 #include <string>
 #include <deque>
@@ -20,6 +22,10 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
     int GetNoResultRequests() const;
+
+    // Opt-in capture: every following request is written to query_log with its time, latency
+    // and result. nullptr stops the capture; the log must outlive it.
+    void SetQueryLog(QueryLogWriter* query_log);
 private:
     struct QueryResult {
         std::vector<Document> document_results_;
@@ -30,12 +36,30 @@ private:
     int no_result_requests_count_;
 
     const SearchServer& server_;
+    QueryLogWriter* query_log_ = nullptr;
+
+    // status is what the log keeps for requests of kind STATUS
+    template <typename DocumentPredicate>
+    std::vector<Document> AddRequest(const std::string& raw_query, DocumentPredicate document_predicate, QueryLogKind kind, DocumentStatus status);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    return AddRequest(raw_query, document_predicate, QueryLogKind::PREDICATE, DocumentStatus::ACTUAL);
+}
 
+template <typename DocumentPredicate>
+std::vector<Document> RequestQueue::AddRequest(const std::string& raw_query, DocumentPredicate document_predicate, QueryLogKind kind, DocumentStatus status) {
+    // Clocks are read only while capturing
+    const auto start_time = query_log_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
     vector<Document> result = server_.FindTopDocuments(raw_query, document_predicate);
+    if (query_log_) {
+        const auto latency = std::chrono::steady_clock::now() - start_time;
+        const auto timestamp = std::chrono::system_clock::now() - latency;
+        query_log_->Write(std::chrono::duration_cast<std::chrono::microseconds>(timestamp.time_since_epoch()).count(),
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count(),
+                          kind, status, raw_query, result);
+    }
     QueryResult query_result = {result, result.empty() ? true : false};
     if(requests_.size() < min_in_day_) {
         if(query_result.no_result) {
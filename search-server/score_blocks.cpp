@@ -0,0 +1,106 @@
+#include "score_blocks.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCORE_BLOCKS_X86
+#endif
+
+using namespace std;
+
+namespace {
+
+double GetMaxScoreScalar(const double* scores, size_t count) {
+    double result = scores[0];
+    for (size_t i = 1; i < count; ++i) {
+        result = max(result, scores[i]);
+    }
+    return result;
+}
+
+#if defined(SCORE_BLOCKS_X86)
+// Two accumulators hide the latency of max
+__attribute__((target("avx2")))
+double GetMaxScoreAvx2(const double* scores, size_t count) {
+    __m256d first = _mm256_loadu_pd(scores);
+    __m256d second = _mm256_loadu_pd(scores + 4);
+    for (size_t i = 8; i < count; i += 8) {
+        first = _mm256_max_pd(first, _mm256_loadu_pd(scores + i));
+        second = _mm256_max_pd(second, _mm256_loadu_pd(scores + i + 4));
+    }
+    first = _mm256_max_pd(first, second);
+    const __m128d half = _mm_max_pd(_mm256_castpd256_pd128(first), _mm256_extractf128_pd(first, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("sse2")))
+double GetMaxScoreSse2(const double* scores, size_t count) {
+    __m128d first = _mm_loadu_pd(scores);
+    __m128d second = _mm_loadu_pd(scores + 2);
+    for (size_t i = 4; i < count; i += 4) {
+        first = _mm_max_pd(first, _mm_loadu_pd(scores + i));
+        second = _mm_max_pd(second, _mm_loadu_pd(scores + i + 2));
+    }
+    first = _mm_max_pd(first, second);
+    return _mm_cvtsd_f64(_mm_max_sd(first, _mm_unpackhi_pd(first, first)));
+}
+#endif
+
+struct MaxScoreKernel {
+    double (*function)(const double*, size_t);
+    const char* name;
+};
+
+MaxScoreKernel SelectMaxScoreKernel() {
+#if defined(SCORE_BLOCKS_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        return {GetMaxScoreAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {GetMaxScoreSse2, "sse2"};
+    }
+#endif
+    return {GetMaxScoreScalar, "scalar"};
+}
+
+const MaxScoreKernel& GetMaxScoreKernel() {
+    static const MaxScoreKernel kernel = SelectMaxScoreKernel();
+    return kernel;
+}
+
+} // namespace
+
+ScoreBlocks::ScoreBlocks(int first_id, int last_id)
+    : first_id_(first_id) {
+    const size_t block_count = (static_cast<size_t>(last_id - first_id) + BLOCK_SIZE) / BLOCK_SIZE;
+    scores_.assign(block_count * BLOCK_SIZE, 0.0);
+    touched_.assign(block_count * WORDS_PER_BLOCK, 0);
+}
+
+size_t ScoreBlocks::GetBlockCount() const {
+    return scores_.size() / BLOCK_SIZE;
+}
+
+bool ScoreBlocks::IsBlockTouched(size_t block) const {
+    const auto first = touched_.begin() + block * WORDS_PER_BLOCK;
+    return any_of(first, first + WORDS_PER_BLOCK, [](uint64_t bits) {
+        return bits != 0;
+    });
+}
+
+vector<double> ScoreBlocks::GetBlockMaxima() const {
+    vector<double> maxima(GetBlockCount());
+    for (size_t block = 0; block < maxima.size(); ++block) {
+        maxima[block] = GetMaxScore(scores_.data() + block * BLOCK_SIZE, BLOCK_SIZE);
+    }
+    return maxima;
+}
+
+double GetMaxScore(const double* scores, size_t count) {
+    return GetMaxScoreKernel().function(scores, count);
+}
+
+const char* GetMaxScoreKernelName() {
+    return GetMaxScoreKernel().name;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance accumulator for term-at-a-time scoring over a range of document ids.
+// Scores are summed in a flat array indexed by id instead of a tree, and the maxima of
+// fixed-size blocks let top-K extraction skip blocks that cannot reach the page.
+class ScoreBlocks {
+public:
+    static constexpr size_t BLOCK_SIZE = 256;
+
+    // Covers ids [first_id, last_id]
+    ScoreBlocks(int first_id, int last_id);
+
+    void Add(int document_id, double score) {
+        const size_t slot = static_cast<size_t>(document_id - first_id_);
+        scores_[slot] += score;
+        touched_[slot / 64] |= uint64_t{1} << (slot % 64);
+    }
+
+    size_t GetBlockCount() const;
+    bool IsBlockTouched(size_t block) const;
+
+    // Bound of every score in each block, untouched slots count as 0
+    std::vector<double> GetBlockMaxima() const;
+
+    // Calls visit(document_id, score) for the touched documents of a block in id order
+    template <typename Visitor>
+    void ForEachTouched(size_t block, Visitor visit) const;
+
+private:
+    static constexpr size_t WORDS_PER_BLOCK = BLOCK_SIZE / 64;
+
+    int first_id_;
+    // Padded to whole blocks
+    std::vector<double> scores_;
+    // Bit per slot: whether any posting was added
+    std::vector<uint64_t> touched_;
+};
+
+template <typename Visitor>
+void ScoreBlocks::ForEachTouched(size_t block, Visitor visit) const {
+    for (size_t word = block * WORDS_PER_BLOCK; word < (block + 1) * WORDS_PER_BLOCK; ++word) {
+        for (uint64_t bits = touched_[word]; bits != 0; bits &= bits - 1) {
+            const size_t slot = word * 64 + __builtin_ctzll(bits);
+            visit(first_id_ + static_cast<int>(slot), scores_[slot]);
+        }
+    }
+}
+
+// Maximum of count scores, count a multiple of 8.
+// Runs the AVX2 kernel when the CPU has it, otherwise SSE2 or plain C++.
+double GetMaxScore(const double* scores, size_t count);
+
+// Kernel GetMaxScore dispatches to: "avx2", "sse2" or "scalar"
+const char* GetMaxScoreKernelName();
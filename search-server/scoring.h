@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+#include <string_view>
+
+// Index statistics of a query word
+struct WordStatistics {
+    std::string_view word;
+    int document_count = 0;             // documents in the index
+    int document_freq = 0;              // documents containing the word
+    double average_document_length = 0; // words per document, stop words excluded
+};
+
+/*
+    Scoring policy interface, resolved at compile time:
+
+    struct Scoring {
+        // Called once per query word
+        PreparedWord PrepareWord(const WordStatistics& statistics, double weight) const;
+        // Called for every posting of the word; must be cheap
+        double Score(const PreparedWord& word, double term_freq, int document_length) const;
+        // Bound of Score over all document lengths, non-decreasing in term_freq;
+        // lets impact-ordered search stop early
+        double UpperBound(const PreparedWord& word, double term_freq) const;
+    };
+
+    term_freq is the share of the word in the document (count / document_length),
+    weight scales the word contribution (1 for ordinary words, lower for fuzzy expansions).
+*/
+
+struct TfIdfScoring {
+    struct PreparedWord {
+        double weighted_idf;
+    };
+
+    PreparedWord PrepareWord(const WordStatistics& statistics, double weight) const {
+        return {weight * std::log(statistics.document_count * 1.0 / statistics.document_freq)};
+    }
+
+    double Score(const PreparedWord& word, double term_freq, int) const {
+        return term_freq * word.weighted_idf;
+    }
+
+    double UpperBound(const PreparedWord& word, double term_freq) const {
+        return term_freq * word.weighted_idf;
+    }
+};
+
+// Okapi BM25
+struct Bm25Scoring {
+    double k1 = 1.2;
+    double b = 0.75;
+
+    struct PreparedWord {
+        double weighted_idf;
+        double k1;
+        double length_norm_base;   // k1 * (1 - b)
+        double length_norm_slope;  // k1 * b / average_document_length
+    };
+
+    PreparedWord PrepareWord(const WordStatistics& statistics, double weight) const {
+        const double n = statistics.document_freq;
+        const double idf = std::log(1.0 + (statistics.document_count - n + 0.5) / (n + 0.5));
+        const double slope = statistics.average_document_length > 0
+            ? k1 * b / statistics.average_document_length
+            : 0.0;
+        return {weight * idf, k1, k1 * (1.0 - b), slope};
+    }
+
+    double Score(const PreparedWord& word, double term_freq, int document_length) const {
+        const double count = term_freq * document_length;
+        const double norm = word.length_norm_base + word.length_norm_slope * document_length;
+        return word.weighted_idf * count * (word.k1 + 1.0) / (count + norm);
+    }
+
+    // With count = term_freq * length the score grows with length, so the limit is the bound
+    double UpperBound(const PreparedWord& word, double term_freq) const {
+        return word.weighted_idf * term_freq * (word.k1 + 1.0) / (term_freq + word.length_norm_slope);
+    }
+};
@@ -0,0 +1,484 @@
+#include "search_daemon.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+// Bytes read from one connection per wakeup, so a fast sender cannot starve the others
+constexpr size_t MAX_READ_PER_WAKEUP = 1 << 20;
+// A connection is not read while it has this much unsent output
+constexpr size_t MAX_PENDING_OUTPUT = 4 << 20;
+// Reading stops once the unparsed input can hold the largest frame
+constexpr size_t MAX_PENDING_INPUT = MAX_FRAME_SIZE + 4;
+constexpr int MAX_EVENTS = 64;
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+bool IsUpdate(RequestType type) {
+    return type == RequestType::ADD_DOCUMENT || type == RequestType::REMOVE_DOCUMENT;
+}
+
+template <typename Body>
+ProtocolResponse Answer(const ProtocolRequest& request, Body body) {
+    ProtocolResponse response;
+    response.request_id = request.request_id;
+    response.type = request.type;
+    try {
+        body(response);
+    } catch (const invalid_argument& e) {
+        response.status = ResponseStatus::INVALID_ARGUMENT;
+        response.error = e.what();
+    } catch (const out_of_range& e) {
+        response.status = ResponseStatus::OUT_OF_RANGE;
+        response.error = e.what();
+    } catch (const MemoryBudgetExceeded& e) {
+        response.status = ResponseStatus::MEMORY_BUDGET_EXCEEDED;
+        response.error = e.what();
+    }
+    return response;
+}
+
+int ListenTcp(const string& address, int& port) {
+    const size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("TCP address must be host:port, got "s + address);
+    }
+    const string host = address.substr(0, colon);
+    const string service = address.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &addresses);
+    if (error != 0) {
+        throw runtime_error("Cannot resolve "s + address + ": "s + gai_strerror(error));
+    }
+    const int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        freeaddrinfo(addresses);
+        ThrowSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    const bool is_bound = bind(fd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+    freeaddrinfo(addresses);
+    if (!is_bound || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        ThrowSystemError("Cannot listen on "s + address);
+    }
+
+    sockaddr_storage bound{};
+    socklen_t bound_size = sizeof(bound);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &bound_size);
+    port = ntohs(bound.ss_family == AF_INET6
+        ? reinterpret_cast<const sockaddr_in6&>(bound).sin6_port
+        : reinterpret_cast<const sockaddr_in&>(bound).sin_port);
+    return fd;
+}
+
+int ListenUnix(const string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Unix socket path is too long: "s + path);
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        ThrowSystemError("Cannot listen on "s + path);
+    }
+    return fd;
+}
+
+} // namespace
+
+struct SearchDaemon::Connection {
+    int fd = -1;
+    string input;
+    // Start of the first unparsed frame in input
+    size_t input_offset = 0;
+    string output;
+    size_t output_offset = 0;
+    // Registered epoll interest
+    uint32_t events = 0;
+    bool is_eof = false;
+    bool is_broken = false;
+
+    size_t GetPendingInput() const {
+        return input.size() - input_offset;
+    }
+
+    size_t GetPendingOutput() const {
+        return output.size() - output_offset;
+    }
+
+    // Size of the next complete frame, 0 if there is none
+    size_t GetNextFrameSize() const {
+        return GetFrameSize(string_view(input).substr(input_offset));
+    }
+
+    void Read() {
+        size_t total = 0;
+        while (total < MAX_READ_PER_WAKEUP && GetPendingInput() < MAX_PENDING_INPUT) {
+            const size_t old_size = input.size();
+            input.resize(old_size + READ_CHUNK_SIZE);
+            const ssize_t count = read(fd, input.data() + old_size, READ_CHUNK_SIZE);
+            input.resize(old_size + max<ssize_t>(count, 0));
+            if (count > 0) {
+                total += count;
+            } else if (count == 0) {
+                is_eof = true;
+                return;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                is_broken = errno != EAGAIN && errno != EWOULDBLOCK;
+                return;
+            }
+        }
+    }
+
+    void Flush() {
+        while (GetPendingOutput() > 0) {
+            const ssize_t count = send(fd, output.data() + output_offset, GetPendingOutput(), MSG_NOSIGNAL);
+            if (count > 0) {
+                output_offset += count;
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else {
+                is_broken = count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                return;
+            }
+        }
+        output.clear();
+        output_offset = 0;
+    }
+
+    // Drops parsed frames from the front of input
+    void CompactInput() {
+        if (input_offset > 0) {
+            input.erase(0, input_offset);
+            input_offset = 0;
+        }
+    }
+};
+
+struct SearchDaemon::IoThread {
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    thread worker;
+    unordered_map<int, unique_ptr<Connection>> connections;
+
+    void Accept(int listen_fd) {
+        while (true) {
+            const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                // EAGAIN: another I/O thread took it; other errors affect only this client
+                return;
+            }
+            const int enable = 1;
+            // Fails harmlessly on Unix sockets
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            auto connection = make_unique<Connection>();
+            connection->fd = fd;
+            connection->events = EPOLLIN;
+            epoll_event event{};
+            event.events = connection->events;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                close(fd);
+                continue;
+            }
+            connections.emplace(fd, move(connection));
+        }
+    }
+
+    void UpdateInterest(Connection& connection) {
+        uint32_t events = 0;
+        if (!connection.is_eof && connection.GetPendingOutput() < MAX_PENDING_OUTPUT
+            && connection.GetPendingInput() < MAX_PENDING_INPUT) {
+            events |= EPOLLIN;
+        }
+        if (connection.GetPendingOutput() > 0) {
+            events |= EPOLLOUT;
+        }
+        if (events != connection.events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.fd = connection.fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.events = events;
+        }
+    }
+
+    void Close(Connection& connection) {
+        const int fd = connection.fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    }
+};
+
+SearchDaemon::SearchDaemon(SearchServer& server, const SearchDaemonConfig& config)
+    : server_(server)
+    , config_(config) {
+    if (config_.tcp_address.empty() && config_.unix_socket_path.empty()) {
+        throw invalid_argument("Daemon needs a TCP address or a Unix socket path"s);
+    }
+    if (config_.io_thread_count <= 0 || config_.max_batch_size == 0) {
+        throw invalid_argument("I/O thread count and batch size must be positive"s);
+    }
+}
+
+SearchDaemon::~SearchDaemon() {
+    Stop();
+}
+
+void SearchDaemon::Listen() {
+    if (!config_.tcp_address.empty()) {
+        listen_fds_.push_back(ListenTcp(config_.tcp_address, tcp_port_));
+    }
+    if (!config_.unix_socket_path.empty()) {
+        listen_fds_.push_back(ListenUnix(config_.unix_socket_path));
+    }
+}
+
+void SearchDaemon::Start() {
+    if (is_running_) {
+        throw logic_error("Daemon is already running"s);
+    }
+    Listen();
+    for (int i = 0; i < config_.io_thread_count; ++i) {
+        auto io_thread = make_unique<IoThread>();
+        io_thread->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        io_thread->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (io_thread->epoll_fd < 0 || io_thread->wake_fd < 0) {
+            ThrowSystemError("Cannot create I/O thread"s);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = io_thread->wake_fd;
+        epoll_ctl(io_thread->epoll_fd, EPOLL_CTL_ADD, io_thread->wake_fd, &event);
+        for (const int listen_fd : listen_fds_) {
+            // Every thread waits on the listeners, EPOLLEXCLUSIVE wakes only one of them
+            event.events = EPOLLIN | EPOLLEXCLUSIVE;
+            event.data.fd = listen_fd;
+            epoll_ctl(io_thread->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+        }
+        io_threads_.push_back(move(io_thread));
+    }
+    is_running_ = true;
+    for (auto& io_thread : io_threads_) {
+        io_thread->worker = thread([this, &io_thread = *io_thread] {
+            RunIoThread(io_thread);
+        });
+    }
+}
+
+void SearchDaemon::Stop() {
+    is_running_ = false;
+    for (auto& io_thread : io_threads_) {
+        const uint64_t wake = 1;
+        [[maybe_unused]] const ssize_t written = write(io_thread->wake_fd, &wake, sizeof(wake));
+    }
+    for (auto& io_thread : io_threads_) {
+        if (io_thread->worker.joinable()) {
+            io_thread->worker.join();
+        }
+        for (const auto& [fd, connection] : io_thread->connections) {
+            close(fd);
+        }
+        close(io_thread->wake_fd);
+        close(io_thread->epoll_fd);
+    }
+    io_threads_.clear();
+    for (const int listen_fd : listen_fds_) {
+        close(listen_fd);
+    }
+    if (!listen_fds_.empty() && !config_.unix_socket_path.empty()) {
+        unlink(config_.unix_socket_path.c_str());
+    }
+    listen_fds_.clear();
+}
+
+int SearchDaemon::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void SearchDaemon::RunIoThread(IoThread& io_thread) {
+    epoll_event events[MAX_EVENTS];
+    // Connections left with complete frames when the previous batch filled up
+    vector<Connection*> pending;
+    while (is_running_) {
+        const int event_count = epoll_wait(io_thread.epoll_fd, events, MAX_EVENTS, pending.empty() ? -1 : 0);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "epoll_wait failed: "s << strerror(errno) << endl;
+            return;
+        }
+
+        vector<Connection*> ready = move(pending);
+        pending.clear();
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == io_thread.wake_fd) {
+                continue;
+            }
+            if (find(listen_fds_.begin(), listen_fds_.end(), fd) != listen_fds_.end()) {
+                io_thread.Accept(fd);
+                continue;
+            }
+            const auto it = io_thread.connections.find(fd);
+            if (it == io_thread.connections.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            if (events[i].events & EPOLLOUT) {
+                connection.Flush();
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                connection.Read();
+            }
+            ready.push_back(&connection);
+        }
+        sort(ready.begin(), ready.end());
+        ready.erase(unique(ready.begin(), ready.end()), ready.end());
+
+        // Frames of all ready connections form one batch; per connection they stay in order
+        vector<ProtocolRequest> requests;
+        vector<Connection*> owners;
+        vector<pair<Connection*, ProtocolResponse>> rejected;
+        for (Connection* connection : ready) {
+            try {
+                size_t frame_size = 0;
+                while (requests.size() < config_.max_batch_size
+                       && connection->GetPendingOutput() < MAX_PENDING_OUTPUT
+                       && (frame_size = connection->GetNextFrameSize()) > 0) {
+                    const string_view frame = string_view(connection->input).substr(connection->input_offset, frame_size);
+                    connection->input_offset += frame_size;
+                    try {
+                        requests.push_back(ParseRequestFrame(frame));
+                        owners.push_back(connection);
+                    } catch (const ProtocolError& e) {
+                        // Frame boundaries are intact: answer after the requests parsed before it
+                        ProtocolResponse response;
+                        response.request_id = GetFrameRequestId(frame);
+                        response.status = ResponseStatus::BAD_REQUEST;
+                        response.error = e.what();
+                        rejected.emplace_back(connection, move(response));
+                        break;
+                    }
+                }
+                if (connection->GetPendingOutput() < MAX_PENDING_OUTPUT && connection->GetNextFrameSize() > 0) {
+                    pending.push_back(connection);
+                }
+            } catch (const ProtocolError&) {
+                // Oversized frame: the stream cannot be resynchronized
+                connection->is_broken = true;
+            }
+        }
+
+        if (!requests.empty()) {
+            const vector<ProtocolResponse> responses = ExecuteBatch(requests);
+            for (size_t i = 0; i < responses.size(); ++i) {
+                AppendResponseFrame(responses[i], owners[i]->output);
+            }
+        }
+        for (const auto& [connection, response] : rejected) {
+            AppendResponseFrame(response, connection->output);
+        }
+
+        for (Connection* connection : ready) {
+            connection->CompactInput();
+            connection->Flush();
+            const bool is_pending = find(pending.begin(), pending.end(), connection) != pending.end();
+            if (connection->is_broken || (connection->is_eof && !is_pending && connection->GetPendingOutput() == 0)) {
+                pending.erase(remove(pending.begin(), pending.end(), connection), pending.end());
+                io_thread.Close(*connection);
+            } else {
+                io_thread.UpdateInterest(*connection);
+            }
+        }
+    }
+}
+
+vector<ProtocolResponse> SearchDaemon::ExecuteBatch(const vector<ProtocolRequest>& requests) {
+    vector<ProtocolResponse> responses(requests.size());
+    // Runs of queries go in parallel, updates split them
+    size_t query_begin = 0;
+    auto execute_queries = [&](size_t query_end) {
+        if (query_begin == query_end) {
+            return;
+        }
+        shared_lock lock(server_mutex_);
+        transform(execution::par, requests.begin() + query_begin, requests.begin() + query_end, responses.begin() + query_begin,
+            [this](const ProtocolRequest& request) {
+                return ExecuteQuery(request);
+            });
+    };
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (IsUpdate(requests[i].type)) {
+            execute_queries(i);
+            unique_lock lock(server_mutex_);
+            responses[i] = ExecuteUpdate(requests[i]);
+            query_begin = i + 1;
+        }
+    }
+    execute_queries(requests.size());
+    return responses;
+}
+
+ProtocolResponse SearchDaemon::ExecuteQuery(const ProtocolRequest& request) const {
+    return Answer(request, [this, &request](ProtocolResponse& response) {
+        if (request.type == RequestType::FIND_TOP_DOCUMENTS) {
+            response.documents = server_.FindTopDocuments(request.text, request.status);
+        } else {
+            const auto [words, status] = server_.MatchDocument(request.text, request.document_id);
+            // Words point into the index, copy them while the lock is held
+            response.words.assign(words.begin(), words.end());
+            response.document_status = status;
+        }
+    });
+}
+
+ProtocolResponse SearchDaemon::ExecuteUpdate(const ProtocolRequest& request) {
+    return Answer(request, [this, &request](ProtocolResponse&) {
+        if (request.type == RequestType::ADD_DOCUMENT) {
+            server_.AddDocument(request.document_id, request.text, request.status, request.ratings);
+        } else {
+            server_.RemoveDocument(request.document_id);
+        }
+    });
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_protocol.h"
+#include "search_server.h"
+
+struct SearchDaemonConfig {
+    // "host:port" to listen on, empty to disable TCP. Port 0 picks a free port.
+    std::string tcp_address;
+    // Unix socket path, empty to disable
+    std::string unix_socket_path;
+    int io_thread_count = 2;
+    // Requests executed per wakeup of an I/O thread
+    size_t max_batch_size = 256;
+};
+
+// Serves a SearchServer over the binary protocol of search_protocol.h (Linux only).
+//
+// Every I/O thread owns an epoll instance and the connections it accepted. A wakeup
+// gathers the complete frames of all ready connections into one batch: runs of
+// consecutive queries are executed in parallel like ProcessQueries under a shared lock,
+// AddDocument and RemoveDocument run alone under an exclusive lock.
+class SearchDaemon {
+public:
+    SearchDaemon(SearchServer& server, const SearchDaemonConfig& config);
+    ~SearchDaemon();
+
+    SearchDaemon(const SearchDaemon&) = delete;
+    SearchDaemon& operator=(const SearchDaemon&) = delete;
+
+    // Binds the listeners and starts the I/O threads, throws std::runtime_error on socket errors
+    void Start();
+    // Closes all connections and joins the I/O threads
+    void Stop();
+
+    // Bound TCP port, 0 if TCP is disabled
+    int GetTcpPort() const;
+
+    // Answers a batch of requests, responses are in request order
+    std::vector<ProtocolResponse> ExecuteBatch(const std::vector<ProtocolRequest>& requests);
+
+private:
+    struct Connection;
+    struct IoThread;
+
+    SearchServer& server_;
+    const SearchDaemonConfig config_;
+    std::shared_mutex server_mutex_;
+
+    std::vector<int> listen_fds_;
+    int tcp_port_ = 0;
+    std::vector<std::unique_ptr<IoThread>> io_threads_;
+    std::atomic<bool> is_running_{false};
+
+    void Listen();
+    void RunIoThread(IoThread& io_thread);
+
+    ProtocolResponse ExecuteQuery(const ProtocolRequest& request) const;
+    ProtocolResponse ExecuteUpdate(const ProtocolRequest& request);
+};
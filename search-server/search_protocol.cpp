@@ -0,0 +1,272 @@
+#include "search_protocol.h"
+
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t SIZE_FIELD_BYTES = 4;
+
+class FrameWriter {
+public:
+    explicit FrameWriter(string& out)
+        : out_(out)
+        , start_(out.size()) {
+        WriteUint32(0);  // size, patched by Finish
+    }
+
+    void WriteUint8(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void WriteUint32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out_.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void WriteInt32(int value) {
+        WriteUint32(static_cast<uint32_t>(value));
+    }
+
+    void WriteDouble(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        WriteUint32(static_cast<uint32_t>(bits));
+        WriteUint32(static_cast<uint32_t>(bits >> 32));
+    }
+
+    void WriteString(string_view value) {
+        WriteUint32(static_cast<uint32_t>(value.size()));
+        out_.append(value.begin(), value.end());
+    }
+
+    void Finish() {
+        const uint32_t size = static_cast<uint32_t>(out_.size() - start_ - SIZE_FIELD_BYTES);
+        for (size_t i = 0; i < SIZE_FIELD_BYTES; ++i) {
+            out_[start_ + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+        }
+    }
+
+private:
+    string& out_;
+    const size_t start_;
+};
+
+class FrameReader {
+public:
+    explicit FrameReader(string_view frame)
+        : data_(frame.substr(SIZE_FIELD_BYTES)) {
+    }
+
+    uint8_t ReadUint8() {
+        return static_cast<uint8_t>(Take(1)[0]);
+    }
+
+    uint32_t ReadUint32() {
+        const string_view bytes = Take(4);
+        uint32_t value = 0;
+        for (int i = 3; i >= 0; --i) {
+            value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+        }
+        return value;
+    }
+
+    int ReadInt32() {
+        return static_cast<int>(ReadUint32());
+    }
+
+    double ReadDouble() {
+        const uint64_t low = ReadUint32();
+        const uint64_t bits = low | (static_cast<uint64_t>(ReadUint32()) << 32);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    string ReadString() {
+        const uint32_t size = ReadUint32();
+        return string(Take(size));
+    }
+
+    // Count of a following array, checked against the remaining bytes
+    uint32_t ReadCount(size_t min_item_size) {
+        const uint32_t count = ReadUint32();
+        if (count > data_.size() / min_item_size) {
+            throw ProtocolError("Array does not fit into the frame"s);
+        }
+        return count;
+    }
+
+    void ExpectEnd() const {
+        if (!data_.empty()) {
+            throw ProtocolError("Unexpected bytes at the end of the frame"s);
+        }
+    }
+
+private:
+    string_view data_;
+
+    string_view Take(size_t size) {
+        if (size > data_.size()) {
+            throw ProtocolError("Truncated frame"s);
+        }
+        const string_view result = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return result;
+    }
+};
+
+DocumentStatus ReadDocumentStatus(FrameReader& reader) {
+    const uint8_t status = reader.ReadUint8();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw ProtocolError("Unknown document status"s);
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+} // namespace
+
+size_t GetFrameSize(string_view buffer) {
+    if (buffer.size() < SIZE_FIELD_BYTES) {
+        return 0;
+    }
+    uint32_t size = 0;
+    for (int i = 3; i >= 0; --i) {
+        size = (size << 8) | static_cast<uint8_t>(buffer[i]);
+    }
+    if (size > MAX_FRAME_SIZE) {
+        throw ProtocolError("Frame of "s + to_string(size) + " bytes is too large"s);
+    }
+    return buffer.size() < SIZE_FIELD_BYTES + size ? 0 : SIZE_FIELD_BYTES + size;
+}
+
+uint32_t GetFrameRequestId(string_view frame) {
+    try {
+        return FrameReader(frame).ReadUint32();
+    } catch (const ProtocolError&) {
+        return 0;
+    }
+}
+
+void AppendRequestFrame(const ProtocolRequest& request, string& out) {
+    FrameWriter writer(out);
+    writer.WriteUint32(request.request_id);
+    writer.WriteUint8(static_cast<uint8_t>(request.type));
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        writer.WriteUint8(static_cast<uint8_t>(request.status));
+        writer.WriteString(request.text);
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        writer.WriteString(request.text);
+        break;
+    case RequestType::ADD_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        writer.WriteUint8(static_cast<uint8_t>(request.status));
+        writer.WriteUint32(static_cast<uint32_t>(request.ratings.size()));
+        for (const int rating : request.ratings) {
+            writer.WriteInt32(rating);
+        }
+        writer.WriteString(request.text);
+        break;
+    case RequestType::REMOVE_DOCUMENT:
+        writer.WriteInt32(request.document_id);
+        break;
+    }
+    writer.Finish();
+}
+
+ProtocolRequest ParseRequestFrame(string_view frame) {
+    FrameReader reader(frame);
+    ProtocolRequest request;
+    request.request_id = reader.ReadUint32();
+    request.type = static_cast<RequestType>(reader.ReadUint8());
+    switch (request.type) {
+    case RequestType::FIND_TOP_DOCUMENTS:
+        request.status = ReadDocumentStatus(reader);
+        request.text = reader.ReadString();
+        break;
+    case RequestType::MATCH_DOCUMENT:
+        request.document_id = reader.ReadInt32();
+        request.text = reader.ReadString();
+        break;
+    case RequestType::ADD_DOCUMENT: {
+        request.document_id = reader.ReadInt32();
+        request.status = ReadDocumentStatus(reader);
+        const uint32_t rating_count = reader.ReadCount(4);
+        request.ratings.reserve(rating_count);
+        for (uint32_t i = 0; i < rating_count; ++i) {
+            request.ratings.push_back(reader.ReadInt32());
+        }
+        request.text = reader.ReadString();
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT:
+        request.document_id = reader.ReadInt32();
+        break;
+    default:
+        throw ProtocolError("Unknown request type "s + to_string(static_cast<int>(request.type)));
+    }
+    reader.ExpectEnd();
+    return request;
+}
+
+void AppendResponseFrame(const ProtocolResponse& response, string& out) {
+    FrameWriter writer(out);
+    writer.WriteUint32(response.request_id);
+    writer.WriteUint8(static_cast<uint8_t>(response.status));
+    if (response.status != ResponseStatus::OK) {
+        writer.WriteString(response.error);
+    } else if (response.type == RequestType::FIND_TOP_DOCUMENTS) {
+        writer.WriteUint32(static_cast<uint32_t>(response.documents.size()));
+        for (const Document& document : response.documents) {
+            writer.WriteInt32(document.id);
+            writer.WriteDouble(document.relevance);
+            writer.WriteInt32(document.rating);
+        }
+    } else if (response.type == RequestType::MATCH_DOCUMENT) {
+        writer.WriteUint8(static_cast<uint8_t>(response.document_status));
+        writer.WriteUint32(static_cast<uint32_t>(response.words.size()));
+        for (const string& word : response.words) {
+            writer.WriteString(word);
+        }
+    }
+    writer.Finish();
+}
+
+ProtocolResponse ParseResponseFrame(string_view frame, RequestType type) {
+    FrameReader reader(frame);
+    ProtocolResponse response;
+    response.request_id = reader.ReadUint32();
+    response.type = type;
+    const uint8_t status = reader.ReadUint8();
+    if (status > static_cast<uint8_t>(ResponseStatus::MEMORY_BUDGET_EXCEEDED)) {
+        throw ProtocolError("Unknown response status"s);
+    }
+    response.status = static_cast<ResponseStatus>(status);
+    if (response.status != ResponseStatus::OK) {
+        response.error = reader.ReadString();
+    } else if (type == RequestType::FIND_TOP_DOCUMENTS) {
+        const uint32_t count = reader.ReadCount(16);
+        response.documents.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            Document document;
+            document.id = reader.ReadInt32();
+            document.relevance = reader.ReadDouble();
+            document.rating = reader.ReadInt32();
+            response.documents.push_back(document);
+        }
+    } else if (type == RequestType::MATCH_DOCUMENT) {
+        response.document_status = ReadDocumentStatus(reader);
+        const uint32_t count = reader.ReadCount(4);
+        response.words.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            response.words.push_back(reader.ReadString());
+        }
+    }
+    reader.ExpectEnd();
+    return response;
+}
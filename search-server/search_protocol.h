@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+/*
+    Binary protocol of the search daemon.
+
+    Every message is a frame: uint32 size of the rest of the frame, uint32 request id,
+    uint8 type (requests) or status (responses), then the payload. Integers are little-endian,
+    doubles are IEEE 754 bit patterns, strings are a uint32 length followed by the bytes.
+
+    Request payloads:
+        FIND_TOP_DOCUMENTS  uint8 document status, string query
+        MATCH_DOCUMENT      int32 document id, string query
+        ADD_DOCUMENT        int32 document id, uint8 document status, uint32 n, n x int32 rating, string text
+        REMOVE_DOCUMENT     int32 document id
+
+    Response payloads for OK:
+        FIND_TOP_DOCUMENTS  uint32 n, n x (int32 id, double relevance, int32 rating)
+        MATCH_DOCUMENT      uint8 document status, uint32 n, n x string word
+        ADD/REMOVE          empty
+    Other statuses carry a string message.
+
+    Clients may pipeline: send many requests without waiting. Responses on a connection
+    come back in request order and echo the request id.
+*/
+
+enum class RequestType : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+enum class ResponseStatus : uint8_t {
+    OK = 0,
+    INVALID_ARGUMENT = 1,
+    OUT_OF_RANGE = 2,
+    BAD_REQUEST = 3,
+    // ADD_DOCUMENT over the index memory budget
+    MEMORY_BUDGET_EXCEEDED = 4,
+};
+
+// Frames above this size are rejected as malformed
+constexpr uint32_t MAX_FRAME_SIZE = 16 << 20;
+
+struct ProtocolRequest {
+    uint32_t request_id = 0;
+    RequestType type = RequestType::FIND_TOP_DOCUMENTS;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    // Query or document text
+    std::string text;
+};
+
+struct ProtocolResponse {
+    uint32_t request_id = 0;
+    RequestType type = RequestType::FIND_TOP_DOCUMENTS;
+    ResponseStatus status = ResponseStatus::OK;
+    std::vector<Document> documents;
+    DocumentStatus document_status = DocumentStatus::ACTUAL;
+    std::vector<std::string> words;
+    std::string error;
+};
+
+// Thrown for truncated or inconsistent frames
+class ProtocolError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Size of the complete frame at the start of buffer, 0 if more bytes are needed.
+// Throws ProtocolError if the announced size exceeds MAX_FRAME_SIZE.
+size_t GetFrameSize(std::string_view buffer);
+
+// Request id of a complete frame, 0 if the frame is too short to hold one
+uint32_t GetFrameRequestId(std::string_view frame);
+
+void AppendRequestFrame(const ProtocolRequest& request, std::string& out);
+ProtocolRequest ParseRequestFrame(std::string_view frame);
+
+// type of the response must be the type of the request it answers
+void AppendResponseFrame(const ProtocolResponse& response, std::string& out);
+// Responses do not carry their type: it is taken from the request
+ProtocolResponse ParseResponseFrame(std::string_view frame, RequestType type);
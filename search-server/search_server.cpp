@@ -15,88 +15,136 @@ SearchServer::SearchServer(const string_view stop_words_text)
 
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (internal_ids_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
+    CheckMemoryBudget();
     const auto words = SplitIntoWordsNoStop(document);
+    generation_.Advance();
+    // The largest internal id so far: postings are only appended to
+    const int internal_id = static_cast<int>(documents_.size());
 
     const double inv_word_count = 1.0 / words.size();
     for (const auto word : words) {
-        word_to_document_freqs_[string(word)][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][string(word)] += inv_word_count;
+        const auto [word_it, is_new_word] = word_to_document_freqs_.try_emplace(string(word));
+        PostingList& word_freqs = word_it->second;
+        if (is_new_word) {
+            term_dictionary_.AddWord(word_it->first);
+            memory_stats_.inverted_index += GetTreeNodeSize<decltype(word_to_document_freqs_)::value_type>() + GetHeapSize(word_it->first);
+        }
+        const size_t postings_memory = word_freqs.GetMemoryUsage();
+        word_freqs.Add(internal_id, inv_word_count);
+        memory_stats_.inverted_index += word_freqs.GetMemoryUsage() - postings_memory;
+        impact_postings_.Invalidate(word);
+        if (has_forward_index_) {
+            document_to_word_freqs_[document_id][string(word)] += inv_word_count;
+        }
+    }
+    if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+        memory_stats_.forward_index += GetTreeNodeSize<decltype(document_to_word_freqs_)::value_type>() + WordFrequenciesCache::GetMemoryUsage(it->second);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    const size_t documents_capacity = documents_.capacity();
+    documents_.push_back({document_id, ComputeAverageRating(ratings), status, static_cast<int>(words.size())});
+    internal_ids_.emplace(document_id, internal_id);
+    total_word_count_ += words.size();
     document_ids_.insert(document_id);
+    memory_stats_.documents += (documents_.capacity() - documents_capacity) * sizeof(DocumentData)
+        + GetTreeNodeSize<decltype(internal_ids_)::value_type>() + GetTreeNodeSize<int>();
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return internal_ids_.size();
 }
 
-tuple<vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-
-    if(document_ids_.count(document_id) == 0) {
-        throw std::out_of_range("document_id does not exist!");
-    }
-    const auto query = ParseQuery(std::execution::seq, raw_query);
-    for (int i = 0; i < 10000; ++i) {
-        string("ahalay-mahalay");
-    }
-    vector<string_view> matched_words(query.plus_words.size());
-    if (document_ids_.count(document_id) == 0) {return { {}, {} };}
+uint64_t SearchServer::GetGeneration() const {
+    return generation_.Get();
+}
 
-   const auto& m = GetWordFrequencies(document_id);
-   auto word_checker = [&m](const auto word){
-       return m.count(string(word));
-   };
+PreparedQuery<> SearchServer::PrepareQuery(const string_view raw_query) const {
+    return PrepareQuery(raw_query, FuzzyMatch{});
+}
 
-    bool is_minus_word = any_of(std::execution::seq, query.minus_words.begin(), query.minus_words.end(), word_checker);
-    if (is_minus_word) { return 
-        {vector<string_view>{}, documents_.at(document_id).status};
-    }
-    copy_if(std::execution::seq, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), word_checker);
-    sort(std::execution::seq, matched_words.begin(),matched_words.end());
-    auto it_last = unique(std::execution::seq, matched_words.begin(), matched_words.end());
-    matched_words.erase(it_last, matched_words.end());
-    it_last = remove(std::execution::seq, matched_words.begin(), matched_words.end(), "");
-    matched_words.erase(it_last, matched_words.end());
-    
-    
-    return { matched_words, documents_.at(document_id).status };
-    
+PreparedQuery<> SearchServer::PrepareQuery(const string_view raw_query, const FuzzyMatch& fuzzy) const {
+    return PrepareQuery(raw_query, fuzzy, TfIdfScoring{});
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+SearchServer::MatchResult SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, const string_view raw_query, int document_id) const {
-    
+SearchServer::MatchResult SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
     if(document_ids_.count(document_id) == 0) {
         throw std::out_of_range("document_id does not exist!");
     }
-    const auto query = ParseQuery(std::execution::par, raw_query);
+    return MatchQuery(ParseQuery(std::execution::seq, raw_query), document_id);
+}
+
+SearchServer::MatchResult SearchServer::MatchDocument(const std::execution::parallel_policy&, const string_view raw_query, int document_id) const {
+    // A single document is matched by one linear merge, there is nothing to split between threads
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+SearchServer::MatchResult SearchServer::MatchQuery(const Query& query, int document_id) const {
+    if (!has_forward_index_) {
+        return MatchQueryByPostings(query, document_id);
+    }
+    const DocumentStatus status = documents_[GetInternalId(document_id)].status;
+    // Both the query words and the document words are sorted: merge them
+    const auto& word_freqs = GetWordFrequencies(document_id);
+    auto word_it = word_freqs.begin();
+    auto skip_to = [&word_it, &word_freqs](const string_view word) {
+        while (word_it != word_freqs.end() && string_view(word_it->first) < word) {
+            ++word_it;
+        }
+        return word_it != word_freqs.end() && word_it->first == word;
+    };
+
+    for (const auto word : query.minus_words) {
+        if (skip_to(word)) {
+            return {vector<string_view>{}, status};
+        }
+    }
+    word_it = word_freqs.begin();
+    for (const auto word : query.required_words) {
+        if (!skip_to(word)) {
+            return {vector<string_view>{}, status};
+        }
+    }
 
-    vector<string_view> matched_words(query.plus_words.size());
+    vector<string_view> matched_words;
+    word_it = word_freqs.begin();
+    for (const auto word : query.plus_words) {
+        if (skip_to(word)) {
+            matched_words.push_back(word_it->first);
+        }
+    }
+    return {matched_words, status};
+}
 
-   const auto& m = GetWordFrequencies(document_id);
-   auto word_checker = [&m](const auto word){
-       return m.count(string(word));
-   };
+SearchServer::MatchResult SearchServer::MatchQueryByPostings(const Query& query, int document_id) const {
+    const int internal_id = GetInternalId(document_id);
+    const DocumentStatus status = documents_[internal_id].status;
+    // The word as stored in the index if the document contains it
+    auto find_word = [this, internal_id](const string_view word) -> const string* {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            return nullptr;
+        }
+        const auto& document_ids = word_it->second.GetDocumentIds();
+        return binary_search(document_ids.begin(), document_ids.end(), internal_id) ? &word_it->first : nullptr;
+    };
 
-    bool is_minus_word = any_of(std::execution::seq, query.minus_words.begin(), query.minus_words.end(), word_checker);
-    if (is_minus_word) { return 
-        {vector<string_view>{}, documents_.at(document_id).status};
+    if (any_of(query.minus_words.begin(), query.minus_words.end(), find_word)
+        || !all_of(query.required_words.begin(), query.required_words.end(), find_word)) {
+        return {vector<string_view>{}, status};
+    }
+    vector<string_view> matched_words;
+    for (const auto word : query.plus_words) {
+        if (const string* indexed_word = find_word(word)) {
+            matched_words.push_back(*indexed_word);
+        }
     }
-    copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), word_checker);
-    sort(matched_words.begin(),matched_words.end());
-    auto it_last = unique(matched_words.begin(), matched_words.end());
-    matched_words.erase(it_last, matched_words.end());
-    it_last = remove(matched_words.begin(), matched_words.end(), "");
-    matched_words.erase(it_last, matched_words.end());
-    
-    
-    return { matched_words, documents_.at(document_id).status };
+    return {matched_words, status};
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
@@ -137,42 +185,37 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
     }
     auto word = text;
     bool is_minus = false;
+    bool is_required = false;
     if (word[0] == '-') {
         is_minus = true;
         word = word.substr(1);
+    } else if (word[0] == '+') {
+        is_required = true;
+        word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw invalid_argument("Query word "s + string(text) + " is invalid");
+    bool is_prefix = false;
+    if (!word.empty() && word.back() == '*') {
+        is_prefix = true;
+        word.remove_suffix(1);
     }
-
-    return {word, is_minus, IsStopWord(word)};
-}
-
-SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_policy&, const string_view text) const {
-    Query result;
-    for (const auto word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data); // ?
-            } else {
-                result.plus_words.push_back(query_word.data); // ?
-            }
-        }
+    if (word.empty() || word[0] == '-' || word[0] == '+' || (is_required && is_prefix) || !IsValidWord(word)) {
+        throw invalid_argument("Query word "s + string(text) + " is invalid");
     }
 
-    return result;
+    return {word, is_minus, !is_prefix && IsStopWord(word), is_prefix, is_required};
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::execution::sequenced_policy&, const string_view text) const {
     Query result;
     for (const auto word : SplitIntoWords(text)) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data); // ?
-            } else {
-                result.plus_words.push_back(query_word.data); // ?
+        auto& words = query_word.is_minus ? result.minus_words : result.plus_words;
+        if (query_word.is_prefix) {
+            ExpandPrefix(query_word.data, words);
+        } else if (!query_word.is_stop) {
+            words.push_back(query_word.data);
+            if (query_word.is_required) {
+                result.required_words.push_back(query_word.data);
             }
         }
     }
@@ -182,21 +225,305 @@ SearchServer::Query SearchServer::ParseQuery(const std::execution::sequenced_pol
     sort(result.minus_words.begin(), result.minus_words.end());
     last = unique(result.minus_words.begin(), result.minus_words.end());
     result.minus_words.erase(last, result.minus_words.end());
+    sort(result.required_words.begin(), result.required_words.end());
+    last = unique(result.required_words.begin(), result.required_words.end());
+    result.required_words.erase(last, result.required_words.end());
     return result;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(string(word)).size());
+shared_ptr<const TermDictionarySnapshot> SearchServer::GetTermDictionary() const {
+    return term_dictionary_.Get([this] {
+        vector<string_view> words;
+        words.reserve(word_to_document_freqs_.size());
+        for (const auto& [word, _] : word_to_document_freqs_) {
+            words.push_back(word);
+        }
+        return TermDictionary(words.begin(), words.end());
+    });
+}
+
+void SearchServer::ExpandPrefix(const string_view prefix, vector<string_view>& words) const {
+    // The snapshot outlives the query: it is only dropped by a modifying call
+    GetTermDictionary()->ForEachWithPrefix(prefix, [&words](const string_view term) {
+        words.push_back(term);
+    });
+}
+
+void SearchServer::ExpandFuzzy(Query& query, const FuzzyMatch& fuzzy) const {
+    if (fuzzy.max_edits < 0 || fuzzy.max_edits > MAX_FUZZY_EDITS) {
+        throw invalid_argument("Fuzzy max_edits must be in [0, "s + to_string(MAX_FUZZY_EDITS) + "]"s);
+    }
+    if (fuzzy.max_edits == 0 || query.plus_words.empty()) {
+        return;
+    }
+    const auto dictionary = GetTermDictionary();
+    map<string_view, double> word_to_weight;
+    for (const auto word : query.plus_words) {
+        dictionary->ForEachWithinDistance(word, fuzzy.max_edits, [&](const string_view term, int distance) {
+            if (distance == 0) {
+                return;
+            }
+            double& weight = word_to_weight[term];
+            weight = max(weight, pow(fuzzy.weight, distance));
+        });
+    }
+    for (const auto word : query.plus_words) {
+        word_to_weight.erase(word);
+    }
+    query.fuzzy_words.assign(word_to_weight.begin(), word_to_weight.end());
+}
+
+WordStatistics SearchServer::GetWordStatistics(const string_view word) const {
+    static const PostingList no_documents;
+    const auto word_it = word_to_document_freqs_.find(word);
+    return GetWordStatistics(word, word_it == word_to_document_freqs_.end() ? no_documents : word_it->second);
+}
+
+WordStatistics SearchServer::GetWordStatistics(const string_view word, const PostingList& postings) const {
+    const int document_count = GetDocumentCount();
+    return {word,
+            document_count,
+            static_cast<int>(postings.size()),
+            document_count > 0 ? static_cast<double>(total_word_count_) / document_count : 0.0};
 }
 
 const map<string, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if(document_to_word_freqs_.find(document_id) == document_to_word_freqs_.end()) {
-        static map<string, double> m;
-        return m;
-    } else {
-        return document_to_word_freqs_.at(document_id);
+    static const map<string, double> empty_word_freqs;
+    if (!has_forward_index_) {
+        if (internal_ids_.count(document_id) == 0) {
+            return empty_word_freqs;
+        }
+        return reconstructed_word_freqs_.Get(document_id, [this, document_id] {
+            return ReconstructWordFrequencies(document_id);
+        });
+    }
+    const auto it = document_to_word_freqs_.find(document_id);
+    return it == document_to_word_freqs_.end() ? empty_word_freqs : it->second;
+}
+
+map<string, double> SearchServer::ReconstructWordFrequencies(int document_id) const {
+    const int internal_id = GetInternalId(document_id);
+    map<string, double> word_freqs;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        const auto& document_ids = postings.GetDocumentIds();
+        const auto it = lower_bound(document_ids.begin(), document_ids.end(), internal_id);
+        if (it != document_ids.end() && *it == internal_id) {
+            word_freqs.emplace_hint(word_freqs.end(), word, postings.GetTermFreqs()[it - document_ids.begin()]);
+        }
+    }
+    return word_freqs;
+}
+
+vector<vector<string_view>> SearchServer::GetDocumentWords() const {
+    vector<vector<string_view>> result(document_ids_.size());
+    if (has_forward_index_) {
+        auto words_it = result.begin();
+        for (const int document_id : document_ids_) {
+            const auto it = document_to_word_freqs_.find(document_id);
+            if (it != document_to_word_freqs_.end()) {
+                for (const auto& [word, _] : it->second) {
+                    words_it->push_back(word);
+                }
+            }
+            ++words_it;
+        }
+        return result;
+    }
+    // Internal ids to positions in external id order
+    vector<size_t> positions(documents_.size());
+    size_t position = 0;
+    for (const int document_id : document_ids_) {
+        positions[internal_ids_.at(document_id)] = position++;
+    }
+    // Words come in order, so every document's list ends up sorted
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        for (const int internal_id : postings.GetDocumentIds()) {
+            result[positions[internal_id]].push_back(word);
+        }
     }
+    return result;
+}
+
+vector<const string*> SearchServer::FindDocumentWords(int document_id, int internal_id) const {
+    vector<const string*> words;
+    if (has_forward_index_) {
+        const auto it = document_to_word_freqs_.find(document_id);
+        if (it != document_to_word_freqs_.end()) {
+            for (const auto& [word, _] : it->second) {
+                words.push_back(&word);
+            }
+        }
+        return words;
+    }
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        const auto& document_ids = postings.GetDocumentIds();
+        if (binary_search(document_ids.begin(), document_ids.end(), internal_id)) {
+            words.push_back(&word);
+        }
+    }
+    return words;
+}
+
+IndexMemoryStats SearchServer::GetMemoryStats() const {
+    IndexMemoryStats stats = memory_stats_;
+    stats.caches = term_dictionary_.GetMemoryUsage()
+        + impact_postings_.GetMemoryUsage()
+        + reconstructed_word_freqs_.GetMemoryUsage();
+    stats.budget = memory_budget_;
+    stats.has_forward_index = has_forward_index_;
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t bytes, MemoryBudgetPolicy policy) {
+    memory_budget_ = bytes;
+    memory_budget_policy_ = policy;
+}
+
+void SearchServer::DropForwardIndex() {
+    document_to_word_freqs_.clear();
+    memory_stats_.forward_index = 0;
+    has_forward_index_ = false;
+}
+
+bool SearchServer::HasForwardIndex() const {
+    return has_forward_index_;
+}
+
+DocumentReorderStats SearchServer::ReorderDocuments() {
+    const auto start_time = chrono::steady_clock::now();
+    DocumentReorderStats stats;
+    stats.document_count = internal_ids_.size();
+
+    // Bisection works on the documents left, numbered densely in their current order
+    vector<int> old_ids;
+    vector<int> dense_ids(documents_.size(), REMOVED_DOCUMENT_ID);
+    for (size_t i = 0; i < documents_.size(); ++i) {
+        if (documents_[i].id != REMOVED_DOCUMENT_ID) {
+            dense_ids[i] = static_cast<int>(old_ids.size());
+            old_ids.push_back(static_cast<int>(i));
+        }
+    }
+    vector<vector<int>> document_terms(old_ids.size());
+    int term_count = 0;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        stats.posting_count += postings.size();
+        stats.encoded_size_before += postings.GetEncodedSize();
+        // A word of one document costs the same wherever the document goes
+        if (postings.size() < 2) {
+            continue;
+        }
+        for (const int internal_id : postings.GetDocumentIds()) {
+            document_terms[dense_ids[internal_id]].push_back(term_count);
+        }
+        ++term_count;
+    }
+
+    const vector<int> order = ComputeBisectionOrder(document_terms, term_count);
+    vector<int> new_ids(documents_.size(), REMOVED_DOCUMENT_ID);
+    vector<DocumentData> documents;
+    documents.reserve(order.size());
+    for (const int dense_id : order) {
+        const DocumentData& document_data = documents_[old_ids[dense_id]];
+        new_ids[old_ids[dense_id]] = static_cast<int>(documents.size());
+        internal_ids_[document_data.id] = static_cast<int>(documents.size());
+        documents.push_back(document_data);
+    }
+    memory_stats_.documents -= (documents_.capacity() - documents.capacity()) * sizeof(DocumentData);
+    documents_ = move(documents);
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        postings.Renumber(new_ids);
+        stats.encoded_size_after += postings.GetEncodedSize();
+    }
+    impact_postings_.Clear();
+    generation_.Advance();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
+
+int SearchServer::GetInternalId(int document_id) const {
+    const auto it = internal_ids_.find(document_id);
+    if (it == internal_ids_.end()) {
+        throw std::out_of_range("document_id does not exist!");
+    }
+    return it->second;
+}
+
+void SearchServer::CheckMemoryBudget() {
+    if (memory_budget_ == 0 || memory_stats_.GetIndexTotal() < memory_budget_) {
+        return;
+    }
+    if (memory_budget_policy_ == MemoryBudgetPolicy::DROP_FORWARD_INDEX && has_forward_index_) {
+        DropForwardIndex();
+        if (memory_stats_.GetIndexTotal() < memory_budget_) {
+            return;
+        }
+    }
+    throw MemoryBudgetExceeded("Index uses "s + to_string(memory_stats_.GetIndexTotal())
+                               + " bytes of "s + to_string(memory_budget_) + " bytes budget"s);
+}
+
+vector<int> SearchServer::FindExcludedDocuments(const Query& query) const {
+    vector<int> excluded_ids;
+    for (const auto word : query.minus_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            continue;
+        }
+        // Postings are sorted, so every word appends a sorted run: merge it in place
+        const auto middle = excluded_ids.size();
+        const auto& document_ids = word_it->second.GetDocumentIds();
+        excluded_ids.insert(excluded_ids.end(), document_ids.begin(), document_ids.end());
+        inplace_merge(excluded_ids.begin(), excluded_ids.begin() + middle, excluded_ids.end());
+    }
+    excluded_ids.erase(unique(excluded_ids.begin(), excluded_ids.end()), excluded_ids.end());
+    return excluded_ids;
+}
+
+vector<int> SearchServer::FindRequiredDocuments(const Query& query, const vector<int>& excluded_ids) const {
+    vector<const PostingList*> postings;
+    for (const auto word : query.required_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            return {};
+        }
+        postings.push_back(&word_it->second);
+    }
+    sort(postings.begin(), postings.end(), [](const PostingList* lhs, const PostingList* rhs) {
+        return lhs->size() < rhs->size();
+    });
+
+    vector<int> document_ids = postings.front()->GetDocumentIds();
+    for (size_t i = 1; i < postings.size() && !document_ids.empty(); ++i) {
+        document_ids = IntersectDocumentIds(document_ids, postings[i]->GetDocumentIds());
+    }
+    vector<int> result;
+    set_difference(document_ids.begin(), document_ids.end(), excluded_ids.begin(), excluded_ids.end(), back_inserter(result));
+    return result;
+}
+
+vector<Document> SearchServer::SelectTopDocuments(const vector<Document>& documents, const SearchCursor& cursor, size_t count) {
+    if (count == 0) {
+        return {};
+    }
+    // The top of the heap is the worst of the best documents seen so far
+    priority_queue<Document, vector<Document>, decltype(&IsMoreRelevant)> best(IsMoreRelevant);
+    for (const Document& document : documents) {
+        if (!cursor.IsBefore(document)) {
+            continue;
+        }
+        if (best.size() < count) {
+            best.push(document);
+        } else if (IsMoreRelevant(document, best.top())) {
+            best.pop();
+            best.push(document);
+        }
+    }
+    vector<Document> result(best.size());
+    for (auto it = result.rbegin(); it != result.rend(); ++it) {
+        *it = best.top();
+        best.pop();
+    }
+    return result;
 }
 
 //simple - raw_query -> policy_seq - status
@@ -204,6 +531,11 @@ vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) con
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+//simple - fuzzy -> policy_seq - status - fuzzy
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, const FuzzyMatch& fuzzy) const {
+    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL, fuzzy);
+}
+
 //simple - status -> policy_seq - predicate
 vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
     return FindTopDocuments(std::execution::seq, raw_query, [status](int, DocumentStatus document_status, int) {
@@ -215,26 +547,21 @@ void SearchServer::RemoveDocument(int document_id) {
     if(document_ids_.find(document_id) == document_ids_.end()) {
         return;
     } else {
-        document_ids_.erase(document_id);
-        documents_.erase(document_id);
-
-        const map<string, double>& m = GetWordFrequencies(document_id);
-        if(!m.empty()) {
-            vector<const string*> v(m.size());
-            transform(std::execution::seq,
-                        m.begin(), m.end(), v.begin(),
-                        [](auto& p){
-                            return &(p.first);
-                        });
-            
+        generation_.Advance();
+        const int internal_id = internal_ids_.at(document_id);
+        // Finding the words needs the document, its data goes last
+        const vector<const string*> v = FindDocumentWords(document_id, internal_id);
+        if(!v.empty()) {
             for_each(std::execution::seq,
                         v.begin(), v.end(),
-                        [this, document_id](const auto word_ptr){
-                            word_to_document_freqs_[*word_ptr].erase(document_id);
+                        [this, internal_id](const auto word_ptr){
+                            word_to_document_freqs_[*word_ptr].Erase(internal_id);
+                            impact_postings_.Invalidate(*word_ptr);
                         });
-            
-            document_to_word_freqs_.erase(document_id);
+            EraseEmptyWords(v);
         }
+        EraseWordFrequencies(document_id);
+        EraseDocumentData(document_id);
     }
 }
 
@@ -246,25 +573,55 @@ void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int do
     if(document_ids_.find(document_id) == document_ids_.end()) {
         return;
     } else {
-        document_ids_.erase(document_id);
-        documents_.erase(document_id);
-
-        const map<string, double>& m = GetWordFrequencies(document_id);
-        if(!m.empty()) {
-            vector<const string*> v(m.size());
-            transform(std::execution::par,
-                        m.begin(), m.end(), v.begin(),
-                        [](auto& p){
-                            return &(p.first);
-                        });
-            
+        generation_.Advance();
+        const int internal_id = internal_ids_.at(document_id);
+        // Finding the words needs the document, its data goes last
+        const vector<const string*> v = FindDocumentWords(document_id, internal_id);
+        if(!v.empty()) {
             for_each(std::execution::par,
                         v.begin(), v.end(),
-                        [this, document_id](const auto word_ptr){
-                            word_to_document_freqs_[*word_ptr].erase(document_id);
+                        [this, internal_id](const auto word_ptr){
+                            word_to_document_freqs_[*word_ptr].Erase(internal_id);
+                            impact_postings_.Invalidate(*word_ptr);
                         });
-            
-            document_to_word_freqs_.erase(document_id);
+            EraseEmptyWords(v);
+        }
+        EraseWordFrequencies(document_id);
+        EraseDocumentData(document_id);
+    }
+}
+void SearchServer::EraseDocumentData(int document_id) {
+    const auto it = internal_ids_.find(document_id);
+    DocumentData& document_data = documents_[it->second];
+    total_word_count_ -= document_data.word_count;
+    // Internal ids of the following documents stay valid; ReorderDocuments drops the entry
+    document_data.id = REMOVED_DOCUMENT_ID;
+    internal_ids_.erase(it);
+    document_ids_.erase(document_id);
+    memory_stats_.documents -= GetTreeNodeSize<decltype(internal_ids_)::value_type>() + GetTreeNodeSize<int>();
+}
+
+void SearchServer::EraseWordFrequencies(int document_id) {
+    if (!has_forward_index_) {
+        reconstructed_word_freqs_.Erase(document_id);
+        return;
+    }
+    const auto it = document_to_word_freqs_.find(document_id);
+    if (it != document_to_word_freqs_.end()) {
+        memory_stats_.forward_index -= GetTreeNodeSize<decltype(document_to_word_freqs_)::value_type>() + WordFrequenciesCache::GetMemoryUsage(it->second);
+        document_to_word_freqs_.erase(it);
+    }
+}
+
+void SearchServer::EraseEmptyWords(const vector<const string*>& words) {
+    // PostingList::Erase keeps the capacity, so the memory of a word is freed only here
+    for (const string* word_ptr : words) {
+        const auto word_it = word_to_document_freqs_.find(*word_ptr);
+        if (word_it != word_to_document_freqs_.end() && word_it->second.empty()) {
+            memory_stats_.inverted_index -= GetTreeNodeSize<decltype(word_to_document_freqs_)::value_type>()
+                + GetHeapSize(word_it->first) + word_it->second.GetMemoryUsage() - sizeof(PostingList);
+            term_dictionary_.RemoveWord(word_it->first);
+            word_to_document_freqs_.erase(word_it);
         }
     }
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -6,17 +7,87 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <queue>
+#include <type_traits>
+#include <unordered_map>
 #include "string_processing.h"
 #include "document.h"
 #include <iostream>
 #include <cmath>
 #include <numeric>
+#include <limits>
+#include <optional>
 #include <execution>
+#include <memory>
+#include <mutex>
 #include "log_duration.h"
 #include "concurrent_map.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "score_blocks.h"
+#include "impact_postings.h"
+#include "index_generation.h"
+#include "memory_stats.h"
+#include "document_reordering.h"
+#include "word_frequencies_cache.h"
+#include "scoring.h"
+#include "query_metrics.h"
 
 constexpr int MAX_RESULT_DOCUMENT_COUNT = 5;
 constexpr double RELEVANCE_EQUALITY_TRESHOLD = 1e-6;
+constexpr int MAX_FUZZY_EDITS = 2;
+// Sequential queries over fewer postings are cheaper to score exhaustively
+constexpr size_t IMPACT_ORDER_MIN_POSTINGS = 4 * ImpactPostings::FIRST_TIER_SIZE;
+// Dense score blocks pay off once a query has a posting per this many ids of its id range
+constexpr size_t SCORE_BLOCKS_MAX_SPARSITY = 16;
+
+// Order of search results: by relevance, then by rating, then by id
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EQUALITY_TRESHOLD) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+// Search-after position for deep pagination: the next page starts right after
+// the last document of the previous one. The default cursor starts at the top.
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+    static SearchCursor After(const Document& last_document) {
+        SearchCursor cursor;
+        cursor.last_document_ = last_document;
+        cursor.is_start_ = false;
+        return cursor;
+    }
+
+    bool IsBefore(const Document& document) const {
+        return is_start_ || IsMoreRelevant(last_document_, document);
+    }
+
+    bool IsAtStart() const {
+        return is_start_;
+    }
+
+private:
+    Document last_document_;
+    bool is_start_ = true;
+};
+
+// Fuzzy search: every plus-word also matches indexed words within max_edits Levenshtein distance.
+// A word found at distance d contributes its relevance multiplied by pow(weight, d).
+struct FuzzyMatch {
+    int max_edits = 0;
+    double weight = 0.5;
+};
+
+template <typename Scoring = TfIdfScoring>
+class PreparedQuery;
 
 class SearchServer {
 public:
@@ -30,6 +101,7 @@ public:
     // Invoke delegating constructor from string container
     explicit SearchServer(const std::string_view stop_words_text);
           
+    // Throws MemoryBudgetExceeded once the index has reached its budget, see SetMemoryBudget
     void AddDocument(int document_id, const string_view document, DocumentStatus status, const std::vector<int>& ratings);
     
     // sequenced policy
@@ -48,13 +120,76 @@ public:
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query) const;
 
+    // fuzzy
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const FuzzyMatch& fuzzy) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const FuzzyMatch& fuzzy) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, const FuzzyMatch& fuzzy) const;
+
+    // scoring policy, see scoring.h; TF-IDF by default
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring) const;
+
+    template <typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, const FuzzyMatch& fuzzy, const Scoring& scoring) const;
+
+    // cursor: next page_size documents after the cursor, pass SearchCursor::After(page.back()) for the next page
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const;
+
+    // Parses raw_query and looks up its words once for repeated execution, see PreparedQuery
+    PreparedQuery<> PrepareQuery(const std::string_view raw_query) const;
+    PreparedQuery<> PrepareQuery(const std::string_view raw_query, const FuzzyMatch& fuzzy) const;
+    template <typename Scoring>
+    PreparedQuery<Scoring> PrepareQuery(const std::string_view raw_query, const FuzzyMatch& fuzzy, const Scoring& scoring) const;
+
+    // prepared query: scored with the policy it was prepared with
+    template <typename Scoring>
+    std::vector<Document> FindTopDocuments(const PreparedQuery<Scoring>& query) const;
+
+    template <typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentStatus status) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentPredicate document_predicate, const SearchCursor& cursor, size_t page_size) const;
+
     int GetDocumentCount() const;
 
+    // Changes on every AddDocument and RemoveDocument, see IndexGeneration
+    uint64_t GetGeneration() const;
+
+    // Statistics the scoring policies see for word, document_freq is 0 for unknown words
+    WordStatistics GetWordStatistics(const std::string_view word) const;
+
     //int GetDocumentId(int index) const;
 
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, const std::string_view raw_query, int document_id) const;
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, const std::string_view raw_query, int document_id) const;
+    // Matched words are sorted and point into the index: valid until the document is removed
+    using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+
+    MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
+    MatchResult MatchDocument(const std::execution::sequenced_policy& policy, const std::string_view raw_query, int document_id) const;
+    MatchResult MatchDocument(const std::execution::parallel_policy& policy, const std::string_view raw_query, int document_id) const;
+    template <typename Scoring>
+    MatchResult MatchDocument(const PreparedQuery<Scoring>& query, int document_id) const;
+
+    // Parses the query once and matches it against every document, results are in document_ids order
+    template <typename ExecutionPolicy>
+    std::vector<MatchResult> MatchDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const;
 
     std::set<int>::const_iterator begin() const {
         return document_ids_.begin();
@@ -72,23 +207,71 @@ public:
         return document_ids_.end();
     }
 
+    // Without the forward index the frequencies are reconstructed by a scan of the whole inverted
+    // index, and only the most recently requested documents are cached (WordFrequenciesCache)
     const map<string, double>& GetWordFrequencies(int document_id) const;
 
+    // Sorted words of every document in begin()..end() order, built in one pass over the forward
+    // or the inverted index and not cached. Views stay valid until the index changes.
+    std::vector<std::vector<std::string_view>> GetDocumentWords() const;
+
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+
+    IndexMemoryStats GetMemoryStats() const;
+
+    // AddDocument checks the index size against bytes before adding a document,
+    // so the index exceeds the budget by one document at most; 0 disables the check
+    void SetMemoryBudget(size_t bytes, MemoryBudgetPolicy policy = MemoryBudgetPolicy::REJECT_DOCUMENTS);
+
+    // Frees document_to_word_freqs_ for good: MatchDocument then looks up the postings
+    // of each query word, GetWordFrequencies and RemoveDocument scan the whole inverted index
+    void DropForwardIndex();
+    bool HasForwardIndex() const;
+
+    // Offline optimization: renumbers documents internally so that those sharing words get
+    // close ids, see ComputeBisectionOrder. Id gaps in the postings shrink and the documents
+    // a query scores lie closer together. External ids and results stay the same.
+    DocumentReorderStats ReorderDocuments();
 private:
+    template <typename Scoring>
+    friend class PreparedQuery;
 
     struct DocumentData {
+        // External id, REMOVED_DOCUMENT_ID once the document is removed
+        int id;
         int rating;
         DocumentStatus status;
+        int word_count;
     };
 
+    static constexpr int REMOVED_DOCUMENT_ID = -1;
+
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    // Postings hold internal ids: dense positions in documents_ given in order of addition
+    // and reassigned by ReorderDocuments
+    std::map<std::string, PostingList, std::less<>> word_to_document_freqs_;
+    std::vector<DocumentData> documents_;
+    // External id to internal id
+    std::map<int, int> internal_ids_;
     std::set<int> document_ids_;
+    // Sum of word_count over documents_, for the average document length
+    int64_t total_word_count_ = 0;
     std::map<int, map<std::string, double>> document_to_word_freqs_;
+    // Compact copy of word_to_document_freqs_ keys for prefix and fuzzy queries, a side index:
+    // exact lookups stay with the map. New and erased words are logged, not rebuilt at once.
+    TermDictionaryCache term_dictionary_;
+    // Postings of frequently queried words in impact order, see FindTopDocumentsByImpact
+    ImpactPostingsCache impact_postings_;
+    // Replaces document_to_word_freqs_ after DropForwardIndex
+    WordFrequenciesCache reconstructed_word_freqs_;
+    bool has_forward_index_ = true;
+    // Index part of GetMemoryStats, kept up to date by AddDocument and RemoveDocument
+    IndexMemoryStats memory_stats_;
+    size_t memory_budget_ = 0;
+    MemoryBudgetPolicy memory_budget_policy_ = MemoryBudgetPolicy::REJECT_DOCUMENTS;
+    IndexGeneration generation_;
 
     bool IsStopWord(const std::string_view word) const;
 
@@ -98,10 +281,33 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // Drops words left without documents after a removal
+    void EraseEmptyWords(const std::vector<const std::string*>& words);
+
+    // Throws std::out_of_range for an unknown document
+    int GetInternalId(int document_id) const;
+
+    // Erases internal_ids_ and document_ids_ entries and leaves a removed entry in documents_
+    void EraseDocumentData(int document_id);
+
+    // Erases the forward index or reconstructed entry of a removed document
+    void EraseWordFrequencies(int document_id);
+
+    // Words of a document for its removal, without the reconstruction cache: keys of the
+    // forward index, or of the inverted index found by a binary search in every word's postings
+    std::vector<const std::string*> FindDocumentWords(int document_id, int internal_id) const;
+
+    void CheckMemoryBudget();
+
+    // Scans the postings of every indexed word
+    map<string, double> ReconstructWordFrequencies(int document_id) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        bool is_required;
     };
 
     QueryWord ParseQueryWord(const std::string_view text) const;
@@ -109,21 +315,172 @@ private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // Plus-words marked with '+': matched documents must contain all of them
+        std::vector<std::string_view> required_words;
+        // Words reached by fuzzy expansion of plus_words with their relevance weights
+        std::vector<std::pair<std::string_view, double>> fuzzy_words;
     };
 
-    Query ParseQuery(const std::execution::parallel_policy&, const string_view text) const;
+    // Query with its words looked up in one generation of the index: everything executing it
+    // needs besides the documents. Prepared queries keep it between executions.
+    template <typename Scoring>
+    struct ResolvedQuery {
+        using PreparedWord = decltype(std::declval<const Scoring&>().PrepareWord(WordStatistics{}, 1.0));
+
+        struct ScoredWord {
+            // Points into the index
+            std::string_view word;
+            const PostingList* postings;
+            PreparedWord prepared;
+        };
+
+        // Query text of a prepared query, which query refers to
+        std::string text;
+        Query query;
+        uint64_t generation = 0;
+        // Indexed plus-words, then fuzzy expansions: the order relevance is summed in
+        std::vector<ScoredWord> scored_words;
+        size_t posting_count = 0;
+        // Sorted internal ids of documents containing any minus-word
+        std::vector<int> excluded_ids;
+        // With required words: sorted internal ids of documents containing all of them and no minus-word
+        std::vector<int> required_ids;
+    };
+
+    // Fills everything but query, which must be parsed already
+    template <typename Scoring>
+    void ResolveQuery(ResolvedQuery<Scoring>& resolved, const Scoring& scoring) const;
+
+    // Resolution of the current generation: the cached one or a new one stored in query
+    template <typename Scoring>
+    std::shared_ptr<const ResolvedQuery<Scoring>> GetResolvedQuery(const PreparedQuery<Scoring>& query) const;
+
+    template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+    std::vector<Document> FindTopResolvedDocuments(const ExecutionPolicy& policy, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const;
+
+    std::shared_ptr<const TermDictionarySnapshot> GetTermDictionary() const;
+
+    // Appends every indexed word starting with prefix
+    void ExpandPrefix(const std::string_view prefix, std::vector<std::string_view>& words) const;
+
+    // Plus, minus and required words come out sorted and unique
     Query ParseQuery(const std::execution::sequenced_policy&, const string_view text) const;
 
     // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    MatchResult MatchQuery(const Query& query, int document_id) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    // MatchQuery without the forward index: binary search in the postings of each query word
+    MatchResult MatchQueryByPostings(const Query& query, int document_id) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    void ExpandFuzzy(Query& query, const FuzzyMatch& fuzzy) const;
+
+    WordStatistics GetWordStatistics(const std::string_view word, const PostingList& postings) const;
+
+    // Sorted internal ids of documents containing any minus-word
+    std::vector<int> FindExcludedDocuments(const Query& query) const;
+
+    // Sorted internal ids of documents containing every required word and no minus-word.
+    // Postings are intersected from the shortest one, so the cost follows the rarest word.
+    std::vector<int> FindRequiredDocuments(const Query& query, const std::vector<int>& excluded_ids) const;
+
+    // Best count documents after cursor in IsMoreRelevant order, selected with a bounded heap
+    static std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, const SearchCursor& cursor, size_t count);
+
+    // Score-at-a-time top page: reads the tiers of all query words in order of their score bound
+    // and stops once no unread posting can change the page. Candidates near the page boundary
+    // are then rescored exactly, so the result equals the exhaustive one.
+    template <typename DocumentPredicate, typename Scoring>
+    std::vector<Document> FindTopDocumentsByImpact(const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring, size_t page_size) const;
+
+    // Calls visit(index) for the postings of a query word that can match: those of documents
+    // with every required word if there are any, otherwise those without minus-words
+    template <typename Scoring, typename Visitor>
+    static void ForEachScoredPosting(const ResolvedQuery<Scoring>& resolved, const PostingList& postings, Visitor visit);
+
+    // Internal ids of all documents the query can match lie in [first, second]; empty if there are none
+    template <typename Scoring>
+    static std::optional<std::pair<int, int>> GetScoredIdRange(const ResolvedQuery<Scoring>& resolved);
+
+    // Term-at-a-time scoring into ScoreBlocks, then top-K extraction from the blocks
+    // in order of their maxima, stopping at the first one below the page
+    template <typename DocumentPredicate, typename Scoring>
+    std::vector<Document> FindTopDocumentsByBlocks(const ResolvedQuery<Scoring>& resolved, int first_id, int last_id, DocumentPredicate document_predicate, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename DocumentPredicate, typename Scoring>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring) const;
+
+    template <typename DocumentPredicate, typename Scoring>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring) const;
 };
 
+// Query parsed once and resolved against a SearchServer index: postings of its words, their
+// prepared statistics (IDF for TF-IDF) and the minus-word exclusion set. Executions reuse all
+// of that; after the index changes the next execution resolves the query again.
+// Copies share the resolution. Concurrent executions are safe, as for raw queries.
+template <typename Scoring>
+class PreparedQuery {
+public:
+    PreparedQuery(const PreparedQuery& other);
+    PreparedQuery& operator=(const PreparedQuery& other);
+
+    const std::string& GetRawQuery() const;
+
+    // Index generation of the current resolution
+    uint64_t GetGeneration() const;
+
+private:
+    friend class SearchServer;
+
+    PreparedQuery(const std::string_view raw_query, const FuzzyMatch& fuzzy, const Scoring& scoring);
+
+    std::string raw_query_;
+    FuzzyMatch fuzzy_;
+    Scoring scoring_;
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const SearchServer::ResolvedQuery<Scoring>> resolved_;
+};
+
+template <typename Scoring>
+PreparedQuery<Scoring>::PreparedQuery(const std::string_view raw_query, const FuzzyMatch& fuzzy, const Scoring& scoring)
+    : raw_query_(raw_query)
+    , fuzzy_(fuzzy)
+    , scoring_(scoring)
+{
+}
+
+template <typename Scoring>
+PreparedQuery<Scoring>::PreparedQuery(const PreparedQuery& other)
+    : raw_query_(other.raw_query_)
+    , fuzzy_(other.fuzzy_)
+    , scoring_(other.scoring_)
+{
+    std::lock_guard guard(other.mutex_);
+    resolved_ = other.resolved_;
+}
+
+template <typename Scoring>
+PreparedQuery<Scoring>& PreparedQuery<Scoring>::operator=(const PreparedQuery& other) {
+    if (this != &other) {
+        std::scoped_lock guard(mutex_, other.mutex_);
+        raw_query_ = other.raw_query_;
+        fuzzy_ = other.fuzzy_;
+        scoring_ = other.scoring_;
+        resolved_ = other.resolved_;
+    }
+    return *this;
+}
+
+template <typename Scoring>
+const std::string& PreparedQuery<Scoring>::GetRawQuery() const {
+    return raw_query_;
+}
+
+template <typename Scoring>
+uint64_t PreparedQuery<Scoring>::GetGeneration() const {
+    std::lock_guard guard(mutex_);
+    return resolved_ ? resolved_->generation : 0;
+}
+
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
     : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
@@ -131,6 +488,25 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw invalid_argument("Some of stop words are invalid"s);
     }
+    for (const std::string& word : stop_words_) {
+        memory_stats_.stop_words += GetTreeNodeSize<std::string>() + GetHeapSize(word);
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    for (const int document_id : document_ids) {
+        if (document_ids_.count(document_id) == 0) {
+            throw std::out_of_range("document_id does not exist!");
+        }
+    }
+    const Query query = ParseQuery(std::execution::seq, raw_query);
+    std::vector<MatchResult> results(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), results.begin(),
+        [this, &query](int document_id) {
+            return MatchQuery(query, document_id);
+        });
+    return results;
 }
 
 //simple - predicate -> template - predicate
@@ -146,33 +522,50 @@ std::vector<Document> SearchServer::FindTopDocuments(const string_view raw_query
     Исключение аргумента policy из сигнатуры функции и 9 перегрузок позволяют пройти тесты.
 */
 
-//The Main Common Template Version (Policy Predicate)
+//policy - predicate -> policy - predicate - fuzzy
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentPredicate document_predicate) const {
-    Query query;
-    std::vector<Document> matched_documents;
-    {
-        //LOG_DURATION("Parallel FindTopDocuments. ParseQuery");
-        query = ParseQuery(std::execution::seq, raw_query);
-    }
-    {
-        //LOG_DURATION("Parallel FindTopDocuments. FindAllDocuments");
-        matched_documents = std::move(FindAllDocuments(policy, query, document_predicate));
-    }
+    return FindTopDocuments(policy, raw_query, document_predicate, FuzzyMatch{});
+}
+
+//policy - predicate - fuzzy -> policy - predicate - fuzzy - scoring
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, fuzzy, TfIdfScoring{});
+}
+
+//policy - predicate - fuzzy - scoring -> policy - predicate - fuzzy - scoring - cursor
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, fuzzy, scoring, SearchCursor{}, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+//policy - predicate - cursor -> policy - predicate - fuzzy - scoring - cursor
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentPredicate document_predicate, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, FuzzyMatch{}, TfIdfScoring{}, cursor, page_size);
+}
+
+//policy - cursor -> policy - predicate - cursor
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments(policy, raw_query, [](int, DocumentStatus document_status, int) {
+        return document_status == DocumentStatus::ACTUAL;
+    }, cursor, page_size);
+}
+
+//The Main Common Template Version (Policy Predicate Fuzzy Scoring Cursor)
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const {
+    QueryMetrics::AddQuery();
+    ResolvedQuery<Scoring> resolved;
     {
-        //LOG_DURATION("Parallel FindTopDocuments. Sort");
-        sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (abs(lhs.relevance - rhs.relevance) < RELEVANCE_EQUALITY_TRESHOLD) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
+        QUERY_STAGE(QueryStage::PARSE);
+        resolved.query = ParseQuery(std::execution::seq, raw_query);
+        ExpandFuzzy(resolved.query, fuzzy);
     }
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    ResolveQuery(resolved, scoring);
+    return FindTopResolvedDocuments(policy, resolved, document_predicate, scoring, cursor, page_size);
 }
 
 //policy - status -> policy - predicate
@@ -189,79 +582,445 @@ vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, c
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    //cout << "IN: debug FindAllDocuments Seq" << endl;
-    map<int, double> document_to_relevance;
-    
+//policy - status - fuzzy -> policy - predicate - fuzzy
+template <typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentStatus status, const FuzzyMatch& fuzzy) const {
+    return FindTopDocuments(policy, raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    }, fuzzy);
+}
+
+//policy - status - fuzzy - scoring -> policy - predicate - fuzzy - scoring
+template <typename ExecutionPolicy, typename Scoring>
+vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, DocumentStatus status, const FuzzyMatch& fuzzy, const Scoring& scoring) const {
+    return FindTopDocuments(policy, raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    }, fuzzy, scoring);
+}
+
+//policy - fuzzy -> policy - status - fuzzy
+template <typename ExecutionPolicy>
+vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const string_view raw_query, const FuzzyMatch& fuzzy) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL, fuzzy);
+}
+
+//prepared: seq - prepared -> policy - prepared - status
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery<Scoring>& query) const {
+    return FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL);
+}
+
+//policy - prepared - status -> policy - prepared - predicate
+template <typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentStatus status) const {
+    return FindTopDocuments(policy, query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+//policy - prepared - predicate -> policy - prepared - predicate - cursor
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, query, document_predicate, SearchCursor{}, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery<Scoring>& query, DocumentPredicate document_predicate, const SearchCursor& cursor, size_t page_size) const {
+    QueryMetrics::AddQuery();
+    const auto resolved = GetResolvedQuery(query);
+    return FindTopResolvedDocuments(policy, *resolved, document_predicate, query.scoring_, cursor, page_size);
+}
+
+template <typename Scoring>
+PreparedQuery<Scoring> SearchServer::PrepareQuery(const std::string_view raw_query, const FuzzyMatch& fuzzy, const Scoring& scoring) const {
+    PreparedQuery<Scoring> query(raw_query, fuzzy, scoring);
+    // Resolved right away, so a malformed query throws here
+    GetResolvedQuery(query);
+    return query;
+}
+
+template <typename Scoring>
+SearchServer::MatchResult SearchServer::MatchDocument(const PreparedQuery<Scoring>& query, int document_id) const {
+    if (document_ids_.count(document_id) == 0) {
+        throw std::out_of_range("document_id does not exist!");
+    }
+    return MatchQuery(GetResolvedQuery(query)->query, document_id);
+}
 
+template <typename Scoring>
+std::shared_ptr<const SearchServer::ResolvedQuery<Scoring>> SearchServer::GetResolvedQuery(const PreparedQuery<Scoring>& query) const {
+    {
+        std::lock_guard guard(query.mutex_);
+        if (query.resolved_ && query.resolved_->generation == generation_.Get()) {
+            return query.resolved_;
+        }
+    }
+    // Parsed from its own copy of the text: the words must outlive query moves
+    auto resolved = std::make_shared<ResolvedQuery<Scoring>>();
+    resolved->text = query.raw_query_;
+    {
+        QUERY_STAGE(QueryStage::PARSE);
+        resolved->query = ParseQuery(std::execution::seq, resolved->text);
+        ExpandFuzzy(resolved->query, query.fuzzy_);
+    }
+    ResolveQuery(*resolved, query.scoring_);
+    std::lock_guard guard(query.mutex_);
+    query.resolved_ = resolved;
+    return resolved;
+}
+
+template <typename Scoring>
+void SearchServer::ResolveQuery(ResolvedQuery<Scoring>& resolved, const Scoring& scoring) const {
+    const Query& query = resolved.query;
+    resolved.generation = generation_.Get();
+    auto add_word = [&](const string_view word, double weight) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            return;
+        }
+        const PostingList& postings = word_it->second;
+        resolved.scored_words.push_back({word_it->first, &postings, scoring.PrepareWord(GetWordStatistics(word, postings), weight)});
+        resolved.posting_count += postings.size();
+    };
     for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(string(word)) == 0) {
-            continue;
+        add_word(word, 1.0);
+    }
+    for (const auto& [word, weight] : query.fuzzy_words) {
+        add_word(word, weight);
+    }
+    {
+        QUERY_STAGE(QueryStage::MINUS_WORDS);
+        resolved.excluded_ids = FindExcludedDocuments(query);
+    }
+    if (!query.required_words.empty()) {
+        resolved.required_ids = FindRequiredDocuments(query, resolved.excluded_ids);
+    }
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scoring>
+std::vector<Document> SearchServer::FindTopResolvedDocuments(const ExecutionPolicy& policy, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        // Sequential first pages over few postings are cheaper to score exhaustively
+        if (cursor.IsAtStart() && resolved.query.required_words.empty() && resolved.posting_count >= IMPACT_ORDER_MIN_POSTINGS) {
+            return FindTopDocumentsByImpact(resolved, document_predicate, scoring, page_size);
+        }
+        const auto id_range = GetScoredIdRange(resolved);
+        if (!id_range) {
+            return {};
+        }
+        const auto [first_id, last_id] = *id_range;
+        const size_t posting_count = resolved.query.required_words.empty()
+            ? resolved.posting_count
+            : resolved.required_ids.size() * resolved.scored_words.size();
+        if (static_cast<size_t>(last_id - first_id) / SCORE_BLOCKS_MAX_SPARSITY < posting_count) {
+            return FindTopDocumentsByBlocks(resolved, first_id, last_id, document_predicate, scoring, cursor, page_size);
+        }
+    }
+    const std::vector<Document> matched_documents = FindAllDocuments(policy, resolved, document_predicate, scoring);
+    QUERY_STAGE(QueryStage::SORT);
+    return SelectTopDocuments(matched_documents, cursor, page_size);
+}
+
+template <typename DocumentPredicate, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring, size_t page_size) const {
+    if (page_size == 0) {
+        return {};
+    }
+    const std::vector<int>& excluded_ids = resolved.excluded_ids;
+
+    struct ImpactWord {
+        const PostingList* postings;
+        std::shared_ptr<const ImpactPostings> impacts;
+        typename ResolvedQuery<Scoring>::PreparedWord prepared;
+        size_t next_tier;
+        // Score bound of any unread posting of the word, 0 when all are read
+        double bound;
+    };
+    std::vector<ImpactWord> words;
+    std::unordered_map<int, double> document_to_bound;
+    std::vector<Document> candidates;
+    {
+        QUERY_STAGE(QueryStage::POSTING_SCAN);
+        for (const auto& word : resolved.scored_words) {
+            auto impacts = impact_postings_.Get(word.word, *word.postings);
+            const double bound = scoring.UpperBound(word.prepared, impacts->GetTierMaxTermFreq(0));
+            words.push_back({word.postings, std::move(impacts), word.prepared, 0, bound});
+        }
+
+        // Smallest score the page is guaranteed to reach, and the bound of documents not seen yet
+        auto get_page_threshold = [&]() {
+            std::vector<double> scores;
+            scores.reserve(document_to_bound.size());
+            for (const auto& [internal_id, score] : document_to_bound) {
+                scores.push_back(score);
+            }
+            std::nth_element(scores.begin(), scores.begin() + (page_size - 1), scores.end(), std::greater<>());
+            return scores[page_size - 1];
+        };
+        auto get_unread_bound = [&words]() {
+            double result = 0.0;
+            for (const auto& word : words) {
+                result += word.bound;
+            }
+            return result;
+        };
+
+        bool is_exhausted = false;
+        while (!is_exhausted) {
+            auto word_it = std::max_element(words.begin(), words.end(), [](const ImpactWord& lhs, const ImpactWord& rhs) {
+                const bool lhs_done = lhs.next_tier == lhs.impacts->GetTierCount();
+                const bool rhs_done = rhs.next_tier == rhs.impacts->GetTierCount();
+                return lhs_done != rhs_done ? lhs_done : lhs.bound < rhs.bound;
+            });
+            if (word_it == words.end() || word_it->next_tier == word_it->impacts->GetTierCount()) {
+                break;
+            }
+            ImpactWord& word = *word_it;
+            const std::vector<int>& document_ids = word.impacts->GetDocumentIds();
+            const std::vector<double>& term_freqs = word.impacts->GetTermFreqs();
+            const size_t tier_end = word.impacts->GetTierBegin(word.next_tier + 1);
+            for (size_t index = word.impacts->GetTierBegin(word.next_tier); index < tier_end; ++index) {
+                const int internal_id = document_ids[index];
+                if (std::binary_search(excluded_ids.begin(), excluded_ids.end(), internal_id)) {
+                    continue;
+                }
+                const DocumentData& document_data = documents_[internal_id];
+                if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                    document_to_bound[internal_id] += scoring.Score(word.prepared, term_freqs[index], document_data.word_count);
+                }
+            }
+            QueryMetrics::AddPostingsScanned(tier_end - word.impacts->GetTierBegin(word.next_tier));
+            ++word.next_tier;
+            word.bound = word.next_tier < word.impacts->GetTierCount()
+                ? scoring.UpperBound(word.prepared, word.impacts->GetTierMaxTermFreq(word.next_tier))
+                : 0.0;
+
+            is_exhausted = std::all_of(words.begin(), words.end(), [](const ImpactWord& word) {
+                return word.next_tier == word.impacts->GetTierCount();
+            });
+            // Page members score at least the threshold; everything unread scores less
+            if (!is_exhausted && document_to_bound.size() >= page_size
+                && get_unread_bound() < get_page_threshold() - RELEVANCE_EQUALITY_TRESHOLD) {
+                break;
+            }
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(string(word))) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+        // Partial scores are lower bounds; only documents that may still reach the page are kept
+        const double unread_bound = get_unread_bound();
+        const double threshold = document_to_bound.size() >= page_size ? get_page_threshold() : 0.0;
+        for (const auto& [internal_id, score] : document_to_bound) {
+            if (score + unread_bound < threshold - RELEVANCE_EQUALITY_TRESHOLD) {
+                continue;
+            }
+            // Rescored word by word in query order, like FindAllDocuments
+            double relevance = 0.0;
+            const DocumentData& document_data = documents_[internal_id];
+            for (const auto& word : words) {
+                const std::vector<int>& document_ids = word.postings->GetDocumentIds();
+                const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), internal_id);
+                if (it != document_ids.end() && *it == internal_id) {
+                    relevance += scoring.Score(word.prepared, word.postings->GetTermFreqs()[it - document_ids.begin()], document_data.word_count);
+                }
             }
+            candidates.push_back({document_data.id, relevance, document_data.rating});
         }
     }
+    QUERY_STAGE(QueryStage::SORT);
+    return SelectTopDocuments(candidates, SearchCursor{}, page_size);
+}
 
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(string(word)) == 0) {
+template <typename Scoring, typename Visitor>
+void SearchServer::ForEachScoredPosting(const ResolvedQuery<Scoring>& resolved, const PostingList& postings, Visitor visit) {
+    const std::vector<int>& document_ids = postings.GetDocumentIds();
+    if (!resolved.query.required_words.empty()) {
+        // Only documents with all required words are scored: gallop to each of them
+        QueryMetrics::AddPostingsScanned(resolved.required_ids.size());
+        size_t index = 0;
+        for (const int document_id : resolved.required_ids) {
+            index = GallopLowerBound(document_ids, index, document_id);
+            if (index == document_ids.size()) {
+                break;
+            }
+            if (document_ids[index] == document_id) {
+                visit(index);
+            }
+        }
+        return;
+    }
+    QueryMetrics::AddPostingsScanned(postings.size());
+    // Postings and excluded_ids are both sorted by id: walk them together
+    const std::vector<int>& excluded_ids = resolved.excluded_ids;
+    auto excluded_it = excluded_ids.begin();
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        while (excluded_it != excluded_ids.end() && *excluded_it < document_ids[index]) {
+            ++excluded_it;
+        }
+        if (excluded_it != excluded_ids.end() && *excluded_it == document_ids[index]) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(string(word))) {
-            document_to_relevance.erase(document_id);
+        visit(index);
+    }
+}
+
+template <typename Scoring>
+std::optional<std::pair<int, int>> SearchServer::GetScoredIdRange(const ResolvedQuery<Scoring>& resolved) {
+    if (resolved.scored_words.empty()) {
+        return std::nullopt;
+    }
+    if (!resolved.query.required_words.empty()) {
+        if (resolved.required_ids.empty()) {
+            return std::nullopt;
+        }
+        return std::pair{resolved.required_ids.front(), resolved.required_ids.back()};
+    }
+    std::pair range{std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+    for (const auto& word : resolved.scored_words) {
+        const std::vector<int>& document_ids = word.postings->GetDocumentIds();
+        range.first = std::min(range.first, document_ids.front());
+        range.second = std::max(range.second, document_ids.back());
+    }
+    return range;
+}
+
+template <typename DocumentPredicate, typename Scoring>
+std::vector<Document> SearchServer::FindTopDocumentsByBlocks(const ResolvedQuery<Scoring>& resolved, int first_id, int last_id, DocumentPredicate document_predicate, const Scoring& scoring, const SearchCursor& cursor, size_t page_size) const {
+    if (page_size == 0) {
+        return {};
+    }
+    ScoreBlocks scores(first_id, last_id);
+    {
+        QUERY_STAGE(QueryStage::POSTING_SCAN);
+        for (const auto& word : resolved.scored_words) {
+            const std::vector<int>& document_ids = word.postings->GetDocumentIds();
+            const std::vector<double>& term_freqs = word.postings->GetTermFreqs();
+            ForEachScoredPosting(resolved, *word.postings, [&](size_t index) {
+                const int internal_id = document_ids[index];
+                const DocumentData& document_data = documents_[internal_id];
+                if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                    scores.Add(internal_id, scoring.Score(word.prepared, term_freqs[index], document_data.word_count));
+                }
+            });
+        }
+    }
+
+    std::vector<Document> candidates;
+    {
+        QUERY_STAGE(QueryStage::RESULT_BUILD);
+        const std::vector<double> block_maxima = scores.GetBlockMaxima();
+        std::vector<size_t> blocks;
+        for (size_t block = 0; block < block_maxima.size(); ++block) {
+            if (scores.IsBlockTouched(block)) {
+                blocks.push_back(block);
+            }
+        }
+        std::sort(blocks.begin(), blocks.end(), [&block_maxima](size_t lhs, size_t rhs) {
+            return block_maxima[lhs] > block_maxima[rhs];
+        });
+        // Best page_size relevances among the candidates, the smallest on top
+        std::priority_queue<double, std::vector<double>, std::greater<>> page_relevances;
+        for (const size_t block : blocks) {
+            // page_size candidates beat every document of this block and the following ones
+            if (page_relevances.size() == page_size && block_maxima[block] < page_relevances.top() - RELEVANCE_EQUALITY_TRESHOLD) {
+                break;
+            }
+            scores.ForEachTouched(block, [&](int internal_id, double relevance) {
+                const DocumentData& document_data = documents_[internal_id];
+                const Document document{document_data.id, relevance, document_data.rating};
+                if (!cursor.IsBefore(document)) {
+                    return;
+                }
+                candidates.push_back(document);
+                page_relevances.push(relevance);
+                if (page_relevances.size() > page_size) {
+                    page_relevances.pop();
+                }
+            });
         }
     }
+    QUERY_STAGE(QueryStage::SORT);
+    return SelectTopDocuments(candidates, cursor, page_size);
+}
 
+template <typename DocumentPredicate, typename Scoring>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring) const {
+    map<int, double> document_to_relevance;
+    {
+        QUERY_STAGE(QueryStage::POSTING_SCAN);
+        for (const auto& word : resolved.scored_words) {
+            const std::vector<int>& document_ids = word.postings->GetDocumentIds();
+            const std::vector<double>& term_freqs = word.postings->GetTermFreqs();
+            ForEachScoredPosting(resolved, *word.postings, [&](size_t index) {
+                const int internal_id = document_ids[index];
+                const DocumentData& document_data = documents_[internal_id];
+                if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                    document_to_relevance[internal_id] += scoring.Score(word.prepared, term_freqs[index], document_data.word_count);
+                }
+            });
+        }
+    }
+
+    QUERY_STAGE(QueryStage::RESULT_BUILD);
     vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    for (const auto [internal_id, relevance] : document_to_relevance) {
+        const DocumentData& document_data = documents_[internal_id];
+        matched_documents.push_back({document_data.id, relevance, document_data.rating});
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance_cm(8);
+template <typename DocumentPredicate, typename Scoring>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const ResolvedQuery<Scoring>& resolved, DocumentPredicate document_predicate, const Scoring& scoring) const {
+    const std::vector<int>& excluded_ids = resolved.excluded_ids;
+    const bool has_required_words = !resolved.query.required_words.empty();
+    const std::vector<int>& required_ids = resolved.required_ids;
+    // Presized for the documents the postings can reach, so the tables do not grow mid-query
+    ConcurrentMap<int, double> document_to_relevance_cm(8, has_required_words ? required_ids.size() : std::min(resolved.posting_count, documents_.size()));
     {
-        //LOG_DURATION("Inside FindAllDocuments: plus_words cycle:");
-        for_each(std::execution::par,
-            query.plus_words.begin(), query.plus_words.end(),
-            [&document_to_relevance_cm, this, &document_predicate](string_view word){
-                if (word_to_document_freqs_.count(string(word)) == 0) {
-                    return;
+        QUERY_STAGE(QueryStage::POSTING_SCAN);
+        auto add_word_relevance = [&document_to_relevance_cm, this, &document_predicate, &scoring, &excluded_ids, has_required_words, &required_ids](const auto& word){
+            const PostingList& postings = *word.postings;
+            const auto& prepared_word = word.prepared;
+            const std::vector<int>& document_ids = postings.GetDocumentIds();
+            const std::vector<double>& term_freqs = postings.GetTermFreqs();
+            auto add_posting = [&document_to_relevance_cm, this, &document_predicate, &scoring, &prepared_word, &document_ids, &term_freqs](size_t index) {
+                const int internal_id = document_ids[index];
+                const DocumentData& document_data = documents_[internal_id];
+                if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                    document_to_relevance_cm[internal_id].ref_to_value += scoring.Score(prepared_word, term_freqs[index], document_data.word_count);
                 }
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                
-                const std::map<int, double>& documents_with_word = word_to_document_freqs_.at(string(word));
-                for_each(std::execution::par, documents_with_word.begin(), documents_with_word.end(), 
-                [&document_to_relevance_cm, this, &document_predicate, inverse_document_freq](const auto id_tf){
-                    const auto& document_data = documents_.at(id_tf.first);
-                    if (document_predicate(id_tf.first, document_data.status, document_data.rating)) {
-                        document_to_relevance_cm[id_tf.first].ref_to_value += id_tf.second * inverse_document_freq;
+            };
+
+            if (has_required_words) {
+                QueryMetrics::AddPostingsScanned(required_ids.size());
+                for_each(std::execution::par, required_ids.begin(), required_ids.end(),
+                [&document_ids, &add_posting](int document_id) {
+                    const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+                    if (it != document_ids.end() && *it == document_id) {
+                        add_posting(it - document_ids.begin());
                     }
                 });
+                return;
+            }
+            QueryMetrics::AddPostingsScanned(postings.size());
+            // Ids are stored contiguously, so the position of an id gives the index of its frequency
+            for_each(std::execution::par, document_ids.begin(), document_ids.end(),
+            [&document_ids, &excluded_ids, &add_posting](const int& document_id) {
+                if (!std::binary_search(excluded_ids.begin(), excluded_ids.end(), document_id)) {
+                    add_posting(&document_id - document_ids.data());
+                }
             });
+        };
+        for_each(std::execution::par,
+            resolved.scored_words.begin(), resolved.scored_words.end(),
+            add_word_relevance);
     }
 
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(string(word)) == 0) {
-            continue;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(string(word))) {
-            document_to_relevance_cm.erase(document_id);
-        }
-    }
     vector<Document> matched_documents;
     {
-        //LOG_DURATION("Inside FindAllDocuments: vector<Documents> building:");
-        
-        for (const auto [document_id, relevance] : document_to_relevance_cm.BuildOrdinaryMap()) {
-            matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+        QUERY_STAGE(QueryStage::RESULT_BUILD);
+        for (const auto& [internal_id, relevance] : document_to_relevance_cm.BuildVector(std::execution::par)) {
+            const DocumentData& document_data = documents_[internal_id];
+            matched_documents.push_back({document_data.id, relevance, document_data.rating});
         }
     }
     return matched_documents;
@@ -0,0 +1,93 @@
+#include "sharded_search_server.h"
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string& stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text))
+{
+}
+
+ShardedSearchServer::ShardedSearchServer(const NumaPlacement& placement, const string& stop_words_text)
+    : ShardedSearchServer(placement, SplitIntoWords(stop_words_text))
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    SearchServer& shard = GetShardForDocument(document_id);
+    RunOnShardNode(GetShardIndex(document_id), [&] {
+        shard.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    SearchServer& shard = GetShardForDocument(document_id);
+    RunOnShardNode(GetShardIndex(document_id), [&] {
+        shard.RemoveDocument(document_id);
+    });
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+SearchServer::MatchResult ShardedSearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        throw out_of_range("document_id does not exist!");
+    }
+    return GetShardForDocument(document_id).MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+WordStatistics ShardedSearchServer::GetWordStatistics(const string_view word) const {
+    WordStatistics result{word};
+    double total_length = 0;
+    for (const auto& shard : shards_) {
+        const WordStatistics shard_statistics = shard.GetWordStatistics(word);
+        result.document_count += shard_statistics.document_count;
+        result.document_freq += shard_statistics.document_freq;
+        total_length += shard_statistics.average_document_length * shard_statistics.document_count;
+    }
+    if (result.document_count > 0) {
+        result.average_document_length = total_length / result.document_count;
+    }
+    return result;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return shards_.at(index);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    return static_cast<size_t>(document_id / id_range_size_) % shards_.size();
+}
+
+SearchServer& ShardedSearchServer::GetShardForDocument(int document_id) {
+    return shards_[GetShardIndex(document_id)];
+}
+
+const SearchServer& ShardedSearchServer::GetShardForDocument(int document_id) const {
+    return shards_[GetShardIndex(document_id)];
+}
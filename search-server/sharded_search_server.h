@@ -0,0 +1,183 @@
+#pragma once
+#include <execution>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "numa_topology.h"
+#include "scoring.h"
+#include "search_server.h"
+
+// Shards per NUMA node: every node gets its own shards, worker threads pinned to its CPUs
+// and the memory of its shards, which are built on those workers
+struct NumaPlacement {
+    std::vector<NumaNode> nodes = DetectNumaNodes();
+    // More than one lets a query use several cores of a node
+    size_t shards_per_node = 1;
+    // Blocks of consecutive document ids go to one shard, round robin over the shards
+    int id_range_size = 4096;
+};
+
+// Front end over several SearchServer shards; document_id % shard count picks the shard,
+// or document_id / id_range_size with a NUMA placement.
+// Queries fan out to all shards in parallel, their top documents are merged.
+// Shards score with statistics summed over all shards, so relevance matches a single server.
+class ShardedSearchServer {
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(size_t shard_count, const StringContainer& stop_words);
+
+    ShardedSearchServer(size_t shard_count, const std::string& stop_words_text);
+
+    // Adding, removing and searching run on the workers of the shard's node
+    template <typename StringContainer>
+    ShardedSearchServer(const NumaPlacement& placement, const StringContainer& stop_words);
+
+    ShardedSearchServer(const NumaPlacement& placement, const std::string& stop_words_text);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate, typename Scoring>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    WordStatistics GetWordStatistics(const std::string_view word) const;
+
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t index) const;
+
+private:
+    std::vector<SearchServer> shards_;
+    int id_range_size_ = 1;
+    // Empty without a NUMA placement, otherwise one per node
+    std::vector<std::unique_ptr<NodeWorkerPool>> node_pools_;
+    size_t shards_per_node_ = 1;
+
+    // Replaces shard-local word statistics with the global ones
+    template <typename Scoring>
+    class GlobalStatisticsScoring {
+    public:
+        using PreparedWord = typename Scoring::PreparedWord;
+
+        GlobalStatisticsScoring(const ShardedSearchServer& server, const Scoring& scoring)
+            : server_(server)
+            , scoring_(scoring) {
+        }
+
+        PreparedWord PrepareWord(const WordStatistics& statistics, double weight) const {
+            return scoring_.PrepareWord(server_.GetWordStatistics(statistics.word), weight);
+        }
+
+        double Score(const PreparedWord& word, double term_freq, int document_length) const {
+            return scoring_.Score(word, term_freq, document_length);
+        }
+
+        double UpperBound(const PreparedWord& word, double term_freq) const {
+            return scoring_.UpperBound(word, term_freq);
+        }
+
+    private:
+        const ShardedSearchServer& server_;
+        const Scoring& scoring_;
+    };
+
+    size_t GetShardIndex(int document_id) const;
+    SearchServer& GetShardForDocument(int document_id);
+    const SearchServer& GetShardForDocument(int document_id) const;
+
+    // Runs task on a worker of the shard's node, or on the calling thread without NUMA placement
+    template <typename Task>
+    std::invoke_result_t<Task> RunOnShardNode(size_t shard_index, Task task) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const StringContainer& stop_words) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const NumaPlacement& placement, const StringContainer& stop_words)
+    : id_range_size_(placement.id_range_size)
+    , shards_per_node_(placement.shards_per_node) {
+    if (placement.nodes.empty() || placement.shards_per_node == 0 || placement.id_range_size <= 0) {
+        throw std::invalid_argument("NUMA placement needs nodes, shards and a positive id range"s);
+    }
+    for (const NumaNode& node : placement.nodes) {
+        node_pools_.push_back(std::make_unique<NodeWorkerPool>(node));
+    }
+    shards_.reserve(placement.nodes.size() * shards_per_node_);
+    for (size_t i = 0; i < placement.nodes.size() * shards_per_node_; ++i) {
+        // First touch by a pinned worker puts the shard's memory on its node
+        shards_.push_back(node_pools_[i / shards_per_node_]->Submit([&stop_words] {
+            return SearchServer(stop_words);
+        }).get());
+    }
+}
+
+template <typename DocumentPredicate, typename Scoring>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const FuzzyMatch& fuzzy, const Scoring& scoring) const {
+    const GlobalStatisticsScoring<Scoring> global_scoring(*this, scoring);
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    if (node_pools_.empty()) {
+        std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_results.begin(),
+            [&](const SearchServer& shard) {
+                return shard.FindTopDocuments(std::execution::seq, raw_query, document_predicate, fuzzy, global_scoring);
+            });
+    } else {
+        std::vector<std::future<std::vector<Document>>> futures;
+        futures.reserve(shards_.size());
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            futures.push_back(node_pools_[i / shards_per_node_]->Submit([&, i] {
+                return shards_[i].FindTopDocuments(std::execution::seq, raw_query, document_predicate, fuzzy, global_scoring);
+            }));
+        }
+        // The tasks refer to this frame: all of them finish before an exception can leave it
+        for (auto& future : futures) {
+            future.wait();
+        }
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shard_results[i] = futures[i].get();
+        }
+    }
+
+    // Every shard returns its own top, so the global top is among them
+    std::vector<Document> result;
+    for (const auto& documents : shard_results) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+    std::sort(result.begin(), result.end(), IsMoreRelevant);
+    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return result;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(raw_query, document_predicate, FuzzyMatch{}, TfIdfScoring{});
+}
+
+template <typename Task>
+std::invoke_result_t<Task> ShardedSearchServer::RunOnShardNode(size_t shard_index, Task task) const {
+    if (node_pools_.empty()) {
+        return task();
+    }
+    return node_pools_[shard_index / shards_per_node_]->Submit(std::move(task)).get();
+}
@@ -9,7 +9,7 @@ vector<string_view> SplitIntoWords(string_view str) {
     str.remove_prefix(std::min(str.find_first_not_of(" "), str.size()));
     //2. В цикле используйте метод find с одним параметром, 
     // чтобы найти номер позиции первого пробела.
-    while(str != str.end()) {
+    while(!str.empty()) {
         size_t space = str.find(' '); 
         //3. Добавьте в результирующий вектор элемент string_view, полученный вызовом метода substr, 
         // где начальная позиция будет 0, а конечная — найденная позиция пробела или npos.
@@ -11,7 +11,7 @@ vector<string_view> SplitIntoWords(string_view str);
 template <typename StringContainer>
 set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     set<string, std::less<>> non_empty_strings;
-    for (const auto str : strings) {
+    for (const auto& str : strings) {
         if (!str.empty()) {
             non_empty_strings.insert(string(str));
         }
@@ -0,0 +1,152 @@
+#include "term_dictionary.h"
+
+#include "memory_stats.h"
+
+#include <algorithm>
+
+using namespace std;
+
+size_t TermDictionary::size() const {
+    return offsets_.size() - 1;
+}
+
+bool TermDictionary::empty() const {
+    return size() == 0;
+}
+
+string_view TermDictionary::operator[](size_t index) const {
+    return string_view(data_).substr(offsets_[index], offsets_[index + 1] - offsets_[index]);
+}
+
+size_t TermDictionary::LowerBound(string_view term) const {
+    size_t left = 0;
+    size_t right = size();
+    while (left < right) {
+        const size_t middle = left + (right - left) / 2;
+        if ((*this)[middle] < term) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return left;
+}
+
+size_t TermDictionary::Find(string_view term) const {
+    const size_t index = LowerBound(term);
+    if (index < size() && (*this)[index] == term) {
+        return index;
+    }
+    return size();
+}
+
+pair<size_t, size_t> TermDictionary::FindPrefixRange(string_view prefix) const {
+    const size_t first = LowerBound(prefix);
+    return {first, FindPrefixEnd(prefix, first)};
+}
+
+size_t TermDictionary::FindPrefixEnd(string_view prefix, size_t first) const {
+    auto has_prefix = [this, prefix](size_t index) {
+        return (*this)[index].substr(0, prefix.size()) == prefix;
+    };
+    // Gallop first: most skipped ranges are short
+    size_t step = 1;
+    size_t left = first;
+    size_t right = first;
+    while (right < size() && has_prefix(right)) {
+        left = right + 1;
+        right = min(right + step, size());
+        step *= 2;
+    }
+    while (left < right) {
+        const size_t middle = left + (right - left) / 2;
+        if (has_prefix(middle)) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return left;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return sizeof(*this) + data_.capacity() + offsets_.capacity() * sizeof(uint32_t);
+}
+
+size_t TermDictionarySnapshot::GetMemoryUsage() const {
+    size_t result = sizeof(*this) + added_.GetMemoryUsage() + removed_.capacity() * sizeof(string);
+    for (const string& word : removed_) {
+        result += GetHeapSize(word);
+    }
+    return result;
+}
+
+bool TermDictionarySnapshot::IsRemoved(string_view term) const {
+    return !removed_.empty() && binary_search(removed_.begin(), removed_.end(), term);
+}
+
+TermDictionaryCache::TermDictionaryCache(const TermDictionaryCache&) {
+}
+
+TermDictionaryCache& TermDictionaryCache::operator=(const TermDictionaryCache& other) {
+    if (this != &other) {
+        std::lock_guard guard(mutex_);
+        Reset();
+    }
+    return *this;
+}
+
+void TermDictionaryCache::AddWord(string_view word) {
+    std::lock_guard guard(mutex_);
+    if (!frozen_) {
+        return;
+    }
+    snapshot_.reset();
+    if (frozen_->Find(word) == frozen_->size()) {
+        added_.insert(word);
+    } else if (const auto it = removed_.find(word); it != removed_.end()) {
+        removed_.erase(it);
+    }
+    CheckLogSize();
+}
+
+void TermDictionaryCache::RemoveWord(string_view word) {
+    std::lock_guard guard(mutex_);
+    if (!frozen_) {
+        return;
+    }
+    snapshot_.reset();
+    if (added_.erase(word) == 0) {
+        removed_.emplace(word);
+    }
+    CheckLogSize();
+}
+
+size_t TermDictionaryCache::GetMemoryUsage() const {
+    std::lock_guard guard(mutex_);
+    if (!frozen_) {
+        return 0;
+    }
+    size_t result = frozen_->GetMemoryUsage() + added_.size() * GetTreeNodeSize<string_view>();
+    for (const string& word : removed_) {
+        result += GetTreeNodeSize<string>() + GetHeapSize(word);
+    }
+    if (snapshot_) {
+        result += snapshot_->GetMemoryUsage();
+    }
+    return result;
+}
+
+void TermDictionaryCache::Reset() {
+    frozen_.reset();
+    added_.clear();
+    removed_.clear();
+    snapshot_.reset();
+}
+
+void TermDictionaryCache::CheckLogSize() {
+    const size_t change_count = added_.size() + removed_.size();
+    if (change_count > MIN_REBUILD_CHANGES && change_count * change_count > frozen_->size()) {
+        Reset();
+    }
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Read-only dictionary of sorted unique terms.
+// Terms are stored back to back in one buffer, so each term costs its characters
+// plus a 4-byte offset instead of a std::string and a tree node.
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    // [first, last) must be sorted and unique
+    template <typename TermIterator>
+    TermDictionary(TermIterator first, TermIterator last);
+
+    size_t size() const;
+    bool empty() const;
+    std::string_view operator[](size_t index) const;
+
+    // Index of term, size() if absent
+    size_t Find(std::string_view term) const;
+
+    // Half-open range of indexes of terms starting with prefix
+    std::pair<size_t, size_t> FindPrefixRange(std::string_view prefix) const;
+
+    // Calls callback(index, distance) for every term within max_edits Levenshtein distance of word.
+    // Simulates the Levenshtein automaton of word over the sorted terms: automaton rows are shared
+    // by terms with a common prefix, and a prefix that leaves the automaton skips all its terms.
+    template <typename Callback>
+    void ForEachWithinDistance(std::string_view word, int max_edits, Callback callback) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::string data_;
+    std::vector<uint32_t> offsets_{0};
+
+    size_t LowerBound(std::string_view term) const;
+
+    // First index in [first, size()) of a term not starting with prefix,
+    // all terms in [first, result) must start with it
+    size_t FindPrefixEnd(std::string_view prefix, size_t first) const;
+};
+
+template <typename Callback>
+void TermDictionary::ForEachWithinDistance(std::string_view word, int max_edits, Callback callback) const {
+    const size_t row_size = word.size() + 1;
+    // rows[depth * row_size + j] is the edit distance between the first depth characters
+    // of the current term and the first j characters of word
+    std::vector<int> rows(row_size);
+    for (size_t j = 0; j < row_size; ++j) {
+        rows[j] = static_cast<int>(j);
+    }
+    std::string_view current_term;
+    size_t valid_depth = 0;
+
+    for (size_t index = 0; index < size();) {
+        const std::string_view term = (*this)[index];
+        size_t depth = 0;
+        while (depth < valid_depth && depth < term.size() && term[depth] == current_term[depth]) {
+            ++depth;
+        }
+        current_term = term;
+        if (rows.size() < (term.size() + 1) * row_size) {
+            rows.resize((term.size() + 1) * row_size);
+        }
+
+        bool is_dead = false;
+        for (; depth < term.size(); ++depth) {
+            const int* previous = &rows[depth * row_size];
+            int* next = &rows[(depth + 1) * row_size];
+            next[0] = previous[0] + 1;
+            int row_min = next[0];
+            for (size_t j = 1; j < row_size; ++j) {
+                const int substitution = previous[j - 1] + (word[j - 1] == term[depth] ? 0 : 1);
+                next[j] = std::min(std::min(previous[j], next[j - 1]) + 1, substitution);
+                row_min = std::min(row_min, next[j]);
+            }
+            if (row_min > max_edits) {
+                is_dead = true;
+                break;
+            }
+        }
+
+        if (is_dead) {
+            // No term continuing this prefix can get back within max_edits
+            valid_depth = depth;
+            index = FindPrefixEnd(term.substr(0, depth + 1), index + 1);
+            continue;
+        }
+        valid_depth = term.size();
+        const int distance = rows[term.size() * row_size + word.size()];
+        if (distance <= max_edits) {
+            callback(index, distance);
+        }
+        ++index;
+    }
+}
+
+template <typename TermIterator>
+TermDictionary::TermDictionary(TermIterator first, TermIterator last) {
+    for (; first != last; ++first) {
+        const std::string_view term = *first;
+        data_.append(term.begin(), term.end());
+        offsets_.push_back(static_cast<uint32_t>(data_.size()));
+    }
+    data_.shrink_to_fit();
+    offsets_.shrink_to_fit();
+}
+
+// Words of the index at one point in time, as seen by a prefix or fuzzy query:
+// the frozen dictionary without the words removed since it was built, plus the words added since.
+class TermDictionarySnapshot {
+public:
+    // Calls callback(term) for every term starting with prefix
+    template <typename Callback>
+    void ForEachWithPrefix(std::string_view prefix, Callback callback) const;
+
+    // Calls callback(term, distance) for every term within max_edits of word
+    template <typename Callback>
+    void ForEachWithinDistance(std::string_view word, int max_edits, Callback callback) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    friend class TermDictionaryCache;
+
+    std::shared_ptr<const TermDictionary> frozen_;
+    TermDictionary added_;
+    // Sorted
+    std::vector<std::string> removed_;
+
+    bool IsRemoved(std::string_view term) const;
+};
+
+// Term dictionary kept beside the inverted index, an extra copy of its words in compact form.
+// The frozen dictionary is built once; words added and removed afterwards are tracked as a
+// change log, and a query snapshot combines both. The frozen dictionary is rebuilt only once
+// the log outgrows max(MIN_REBUILD_CHANGES, sqrt(size)), so a new word costs O(sqrt(V))
+// amortized instead of a full rebuild before the next query.
+// Readers may call Get concurrently; AddWord and RemoveWord must not race with readers.
+class TermDictionaryCache {
+public:
+    static constexpr size_t MIN_REBUILD_CHANGES = 1024;
+
+    TermDictionaryCache() = default;
+    // The log refers to the words of its index, so a copy starts empty and builds on first use
+    TermDictionaryCache(const TermDictionaryCache& other);
+    TermDictionaryCache& operator=(const TermDictionaryCache& other);
+
+    // word must stay valid until RemoveWord for it: the log keeps a view
+    void AddWord(std::string_view word);
+    // Call before the word is destroyed
+    void RemoveWord(std::string_view word);
+
+    // 0 while nothing is built
+    size_t GetMemoryUsage() const;
+
+    // Builder returns a TermDictionary of all words; it is called only when the frozen
+    // dictionary is missing. The snapshot and the terms it passes out stay valid until
+    // AddWord or RemoveWord.
+    template <typename Builder>
+    std::shared_ptr<const TermDictionarySnapshot> Get(Builder build) const;
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const TermDictionary> frozen_;
+    // Words added since frozen_ was built and not in it
+    std::set<std::string_view> added_;
+    // Words of frozen_ removed since
+    std::set<std::string, std::less<>> removed_;
+    mutable std::shared_ptr<const TermDictionarySnapshot> snapshot_;
+
+    void Reset();
+    // Drops frozen_ once the log outgrows it
+    void CheckLogSize();
+};
+
+template <typename Callback>
+void TermDictionarySnapshot::ForEachWithPrefix(std::string_view prefix, Callback callback) const {
+    const auto [first, last] = frozen_->FindPrefixRange(prefix);
+    for (size_t i = first; i < last; ++i) {
+        if (!IsRemoved((*frozen_)[i])) {
+            callback((*frozen_)[i]);
+        }
+    }
+    const auto [added_first, added_last] = added_.FindPrefixRange(prefix);
+    for (size_t i = added_first; i < added_last; ++i) {
+        callback(added_[i]);
+    }
+}
+
+template <typename Callback>
+void TermDictionarySnapshot::ForEachWithinDistance(std::string_view word, int max_edits, Callback callback) const {
+    frozen_->ForEachWithinDistance(word, max_edits, [&](size_t index, int distance) {
+        if (!IsRemoved((*frozen_)[index])) {
+            callback((*frozen_)[index], distance);
+        }
+    });
+    added_.ForEachWithinDistance(word, max_edits, [&](size_t index, int distance) {
+        callback(added_[index], distance);
+    });
+}
+
+template <typename Builder>
+std::shared_ptr<const TermDictionarySnapshot> TermDictionaryCache::Get(Builder build) const {
+    std::lock_guard guard(mutex_);
+    if (!snapshot_) {
+        if (!frozen_) {
+            frozen_ = std::make_shared<const TermDictionary>(build());
+        }
+        auto snapshot = std::make_shared<TermDictionarySnapshot>();
+        snapshot->frozen_ = frozen_;
+        snapshot->added_ = TermDictionary(added_.begin(), added_.end());
+        snapshot->removed_.assign(removed_.begin(), removed_.end());
+        snapshot_ = std::move(snapshot);
+    }
+    return snapshot_;
+}
@@ -37,9 +37,11 @@ void MatchDocuments(const SearchServer& search_server, const string& query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
 
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto results = search_server.MatchDocuments(execution::par, query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto& [words, status] = results[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     }
     catch (const invalid_argument& e) {
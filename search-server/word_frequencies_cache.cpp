@@ -0,0 +1,81 @@
+#include "word_frequencies_cache.h"
+
+#include "memory_stats.h"
+
+using namespace std;
+
+WordFrequenciesCache::WordFrequenciesCache(const WordFrequenciesCache& other) {
+    lock_guard guard(other.mutex_);
+    CopyFrom(other);
+}
+
+WordFrequenciesCache& WordFrequenciesCache::operator=(const WordFrequenciesCache& other) {
+    if (this != &other) {
+        scoped_lock guard(mutex_, other.mutex_);
+        entries_.clear();
+        lru_.clear();
+        memory_usage_ = 0;
+        CopyFrom(other);
+    }
+    return *this;
+}
+
+void WordFrequenciesCache::Erase(int document_id) {
+    lock_guard guard(mutex_);
+    const auto it = entries_.find(document_id);
+    if (it != entries_.end()) {
+        EraseEntry(it);
+    }
+}
+
+void WordFrequenciesCache::Clear() {
+    lock_guard guard(mutex_);
+    entries_.clear();
+    lru_.clear();
+    memory_usage_ = 0;
+}
+
+size_t WordFrequenciesCache::GetMemoryUsage() const {
+    lock_guard guard(mutex_);
+    return memory_usage_;
+}
+
+size_t WordFrequenciesCache::GetMemoryUsage(const WordFrequencies& word_freqs) {
+    size_t result = word_freqs.size() * GetTreeNodeSize<WordFrequencies::value_type>();
+    for (const auto& [word, _] : word_freqs) {
+        result += GetHeapSize(word);
+    }
+    return result;
+}
+
+const WordFrequenciesCache::WordFrequencies& WordFrequenciesCache::Use(Entry& entry) const {
+    lru_.splice(lru_.begin(), lru_, entry.use);
+    // Keeps the entry alive for the caller even if another thread evicts it
+    thread_local shared_ptr<const WordFrequencies> last_used;
+    last_used = entry.word_freqs;
+    return *last_used;
+}
+
+void WordFrequenciesCache::Insert(int document_id, shared_ptr<const WordFrequencies> word_freqs) const {
+    if (entries_.size() == MAX_DOCUMENT_COUNT) {
+        EraseEntry(entries_.find(lru_.back()));
+    }
+    lru_.push_front(document_id);
+    const size_t memory_usage = GetTreeNodeSize<pair<const int, Entry>>() + GetTreeNodeSize<int>() + sizeof(WordFrequencies)
+        + GetMemoryUsage(*word_freqs);
+    entries_.emplace(document_id, Entry{move(word_freqs), lru_.begin(), memory_usage});
+    memory_usage_ += memory_usage;
+}
+
+void WordFrequenciesCache::EraseEntry(map<int, Entry>::iterator it) const {
+    memory_usage_ -= it->second.memory_usage;
+    lru_.erase(it->second.use);
+    entries_.erase(it);
+}
+
+void WordFrequenciesCache::CopyFrom(const WordFrequenciesCache& other) {
+    // Oldest first, so the copy keeps the order of use
+    for (auto it = other.lru_.rbegin(); it != other.lru_.rend(); ++it) {
+        Insert(*it, other.entries_.at(*it).word_freqs);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Word frequencies of documents rebuilt from the inverted index after the forward index is dropped.
+// Holds the MAX_DOCUMENT_COUNT most recently requested documents, so the dropped forward index
+// does not grow back. Evicted entries stay alive while a thread still holds them: a reference
+// from Get is valid until the same thread calls Get again or the entry is erased.
+// Readers may call Get concurrently; Erase and Clear must not race with readers.
+class WordFrequenciesCache {
+public:
+    using WordFrequencies = std::map<std::string, double>;
+
+    static constexpr size_t MAX_DOCUMENT_COUNT = 256;
+
+    WordFrequenciesCache() = default;
+    WordFrequenciesCache(const WordFrequenciesCache& other);
+    WordFrequenciesCache& operator=(const WordFrequenciesCache& other);
+
+    // Builder returns WordFrequencies; it runs outside the lock and only for a missing entry
+    template <typename Builder>
+    const WordFrequencies& Get(int document_id, Builder build) const;
+
+    void Erase(int document_id);
+    void Clear();
+
+    size_t GetMemoryUsage() const;
+
+    // Tree nodes and word buffers of one document's frequencies
+    static size_t GetMemoryUsage(const WordFrequencies& word_freqs);
+
+private:
+    struct Entry {
+        std::shared_ptr<const WordFrequencies> word_freqs;
+        // Position in lru_
+        std::list<int>::iterator use;
+        size_t memory_usage = 0;
+    };
+
+    mutable std::mutex mutex_;
+    mutable std::map<int, Entry> entries_;
+    // Document ids, most recently used first
+    mutable std::list<int> lru_;
+    mutable size_t memory_usage_ = 0;
+
+    // Called under mutex_: the entry becomes the most recently used one
+    const WordFrequencies& Use(Entry& entry) const;
+    void Insert(int document_id, std::shared_ptr<const WordFrequencies> word_freqs) const;
+    void EraseEntry(std::map<int, Entry>::iterator it) const;
+    void CopyFrom(const WordFrequenciesCache& other);
+};
+
+template <typename Builder>
+const WordFrequenciesCache::WordFrequencies& WordFrequenciesCache::Get(int document_id, Builder build) const {
+    {
+        std::lock_guard guard(mutex_);
+        const auto it = entries_.find(document_id);
+        if (it != entries_.end()) {
+            return Use(it->second);
+        }
+    }
+    auto word_freqs = std::make_shared<const WordFrequencies>(build());
+    std::lock_guard guard(mutex_);
+    // A concurrent reader may have built the same entry, the first one stays
+    if (entries_.count(document_id) == 0) {
+        Insert(document_id, std::move(word_freqs));
+    }
+    return Use(entries_.at(document_id));
+}